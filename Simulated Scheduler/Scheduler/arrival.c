@@ -0,0 +1,210 @@
+/*
+ * arrival.c
+ * Multithreaded OS Simulation - process arrival models
+ *
+ * See arrival.h.  Poisson arrivals are drawn as exponential gaps between
+ * arrivals in continuous time, and rounded down to the tick they fall in.
+ * The time-varying rates of the on/off and diurnal models are drawn by
+ * thinning: candidate arrivals are drawn at the peak rate, and each one is
+ * kept with probability rate(t) / peak.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arrival.h"
+#include "checkpoint.h"
+
+
+typedef enum {
+    ARRIVAL_FIXED = 0,
+    ARRIVAL_POISSON,
+    ARRIVAL_ONOFF,
+    ARRIVAL_DIURNAL,
+    ARRIVAL_TRACE
+} arrival_model_t;
+
+unsigned int arrival_ticks[PROCESS_COUNT];
+
+static unsigned int finish_ticks[PROCESS_COUNT];
+static unsigned long long random_state;
+
+
+/* random_uniform() returns a number in (0, 1], from a xorshift64* generator */
+static double random_uniform(void)
+{
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return ((random_state * 2685821657736338717ULL >> 11) + 1) /
+           9007199254740992.0;
+}
+
+/* rate_at() returns the arrival rate of a model at time t */
+static double rate_at(arrival_model_t model, double rate, double on,
+                      double off, double t)
+{
+    switch (model)
+    {
+    case ARRIVAL_ONOFF:
+        return fmod(t, on + off) < on ? rate : 0.0;
+
+    case ARRIVAL_DIURNAL:
+        return rate * (1.0 + sin(2.0 * M_PI * t / on));
+
+    default:
+        return rate;
+    }
+}
+
+static int compare_ticks(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int*)a, y = *(const unsigned int*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * read_trace() reads the arrival ticks from a file, one per line; blank
+ * lines and lines starting with '#' are skipped.  Arrivals are sorted, so
+ * the file needs not be.
+ */
+static int read_trace(const char *path)
+{
+    char line[128];
+    unsigned int n = 0;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (f == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    while (n < PROCESS_COUNT && fgets(line, sizeof(line), f) != NULL)
+    {
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+            continue;
+        arrival_ticks[n++] = strtoul(line, NULL, 10);
+    }
+    fclose(f);
+
+    if (n < PROCESS_COUNT)
+    {
+        fprintf(stderr, "%s: %u arrivals for %d processes\n", path, n,
+            PROCESS_COUNT);
+        return -1;
+    }
+    qsort(arrival_ticks, PROCESS_COUNT, sizeof(unsigned int), compare_ticks);
+    return 0;
+}
+
+extern int arrival_init(const char *spec, unsigned int seed)
+{
+    arrival_model_t model;
+    double rate = 0.0, on = 0.0, off = 0.0, peak, t = 0.0;
+    unsigned int n, every = 10;
+
+    if (spec == NULL)
+        spec = "fixed:10";
+
+    if (strncmp(spec, "fixed:", 6) == 0)
+    {
+        model = ARRIVAL_FIXED;
+        if (sscanf(spec + 6, "%u", &every) != 1)
+            return -1;
+    }
+    else if (strncmp(spec, "poisson:", 8) == 0)
+    {
+        model = ARRIVAL_POISSON;
+        if (sscanf(spec + 8, "%lf", &rate) != 1)
+            return -1;
+    }
+    else if (strncmp(spec, "onoff:", 6) == 0)
+    {
+        model = ARRIVAL_ONOFF;
+        if (sscanf(spec + 6, "%lf,%lf,%lf", &rate, &on, &off) != 3 ||
+            on <= 0.0 || off < 0.0)
+            return -1;
+    }
+    else if (strncmp(spec, "diurnal:", 8) == 0)
+    {
+        model = ARRIVAL_DIURNAL;
+        if (sscanf(spec + 8, "%lf,%lf", &rate, &on) != 2 || on <= 0.0)
+            return -1;
+    }
+    else if (strncmp(spec, "trace:", 6) == 0)
+    {
+        return read_trace(spec + 6);
+    }
+    else
+    {
+        return -1;
+    }
+
+    if (model == ARRIVAL_FIXED)
+    {
+        for (n=0; n<PROCESS_COUNT; n++)
+            arrival_ticks[n] = n * every;
+        return 0;
+    }
+
+    if (rate <= 0.0)
+        return -1;
+
+    /* xorshift must not be seeded with 0 */
+    random_state = seed * 0x9E3779B97F4A7C15ULL + 1;
+    peak = model == ARRIVAL_DIURNAL ? 2.0 * rate : rate;
+
+    for (n=0; n<PROCESS_COUNT; )
+    {
+        t += -log(random_uniform()) / peak;
+        if (random_uniform() * peak <= rate_at(model, rate, on, off, t))
+            arrival_ticks[n++] = (unsigned int)t;
+    }
+    return 0;
+}
+
+extern void arrival_done(unsigned int pid, unsigned int tick)
+{
+    finish_ticks[pid] = tick;
+}
+
+/*
+ * The turnaround time of a process is the time from its arrival to its
+ * termination.  Percentiles are nearest-rank.
+ */
+extern void arrival_print_stats(void)
+{
+    unsigned int turnaround[PROCESS_COUNT];
+    unsigned long long total = 0;
+    unsigned int n;
+
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        turnaround[n] = finish_ticks[n] - arrival_ticks[n];
+        total += turnaround[n];
+    }
+    qsort(turnaround, PROCESS_COUNT, sizeof(unsigned int), compare_ticks);
+
+    printf("Turnaround time: mean %.1f s, p50 %.1f s, p95 %.1f s, "
+        "p99 %.1f s, max %.1f s\n", (double)total / PROCESS_COUNT / 10.0,
+        turnaround[(PROCESS_COUNT * 50 + 99) / 100 - 1] / 10.0,
+        turnaround[(PROCESS_COUNT * 95 + 99) / 100 - 1] / 10.0,
+        turnaround[(PROCESS_COUNT * 99 + 99) / 100 - 1] / 10.0,
+        turnaround[PROCESS_COUNT - 1] / 10.0);
+}
+
+extern void arrival_save(void)
+{
+    CHECKPOINT_PUT(arrival_ticks);
+    CHECKPOINT_PUT(finish_ticks);
+}
+
+extern void arrival_restore(void)
+{
+    CHECKPOINT_GET(arrival_ticks);
+    CHECKPOINT_GET(finish_ticks);
+}
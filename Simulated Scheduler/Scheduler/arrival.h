@@ -0,0 +1,50 @@
+/*
+ * arrival.h
+ * Multithreaded OS Simulation - process arrival models
+ *
+ * The arrival schedule is drawn once, before the simulation starts: process
+ * n arrives in tick arrival_ticks[n], and the schedule never decreases, so
+ * the simulator admits every process due in a tick in one pass.
+ *
+ * Models, selected with a spec string (rates are in processes per tick):
+ *
+ *   fixed:<ticks>              one process every <ticks> ticks (the default,
+ *                              fixed:10)
+ *   poisson:<rate>             Poisson arrivals
+ *   onoff:<rate>,<on>,<off>    Poisson arrivals for <on> ticks, then none
+ *                              for <off> ticks, repeating
+ *   diurnal:<rate>,<period>    Poisson arrivals whose rate follows a sine
+ *                              wave of <period> ticks between 0 and 2 * rate
+ *   trace:<file>               explicit arrival ticks, one per line
+ */
+
+#ifndef __ARRIVAL_H__
+#define __ARRIVAL_H__
+
+#include "os-sim.h"
+#include "process.h"
+
+
+extern unsigned int arrival_ticks[PROCESS_COUNT];
+
+
+/*
+ * arrival_init() draws the arrival schedule for spec (NULL for the default)
+ *   with the random number generator seeded with seed.  It returns 0, or -1
+ *   if spec is not valid.
+ *
+ * arrival_done() records the tick in which a process terminated.
+ *
+ * arrival_print_stats() prints the distribution of turnaround times.
+ *
+ * arrival_save() and arrival_restore() write the arrival schedule and the
+ *   termination times to the open checkpoint, and read them back.
+ */
+extern int arrival_init(const char *spec, unsigned int seed);
+extern void arrival_done(unsigned int pid, unsigned int tick);
+extern void arrival_print_stats(void);
+extern void arrival_save(void);
+extern void arrival_restore(void);
+
+
+#endif /* __ARRIVAL_H__ */
@@ -0,0 +1,147 @@
+/*
+ * checkpoint.c
+ * Multithreaded OS Simulation - checkpoint files
+ *
+ * See checkpoint.h.  A checkpoint is written to path.tmp and renamed over
+ * path when complete.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "energy.h"
+#include "memory.h"
+#include "os-sim.h"
+#include "process.h"
+
+
+#define CHECKPOINT_MAGIC "ossimckp"
+#define CHECKPOINT_VERSION 8
+
+/* What the layout of a checkpoint depends on */
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    unsigned int process_count;
+    unsigned int lock_count;
+    unsigned int max_working_set;
+    unsigned int cstate_count;
+    unsigned int word_size;
+} checkpoint_header_t;
+
+static FILE *file = NULL;
+static int writing;
+static int failed;
+static long size;
+static char final_path[256];
+static char temp_path[264];
+
+
+static void make_header(checkpoint_header_t *header)
+{
+    memset(header, 0, sizeof(checkpoint_header_t));
+    memcpy(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic));
+    header->version = CHECKPOINT_VERSION;
+    header->process_count = PROCESS_COUNT;
+    header->lock_count = LOCK_COUNT;
+    header->max_working_set = MAX_WORKING_SET;
+    header->cstate_count = CSTATE_COUNT;
+    header->word_size = sizeof(unsigned int);
+}
+
+extern int checkpoint_create(const char *path)
+{
+    checkpoint_header_t header;
+
+    strncpy(final_path, path, sizeof(final_path) - 1);
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", final_path);
+    file = fopen(temp_path, "wb");
+    if (file == NULL)
+    {
+        perror(temp_path);
+        return -1;
+    }
+    writing = 1;
+    failed = 0;
+
+    make_header(&header);
+    checkpoint_put(&header, sizeof(header));
+    return 0;
+}
+
+extern int checkpoint_open(const char *path)
+{
+    checkpoint_header_t expected, header;
+
+    file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    writing = 0;
+    failed = 0;
+    if (fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+        fseek(file, 0, SEEK_SET) != 0)
+        failed = 1;
+
+    make_header(&expected);
+    checkpoint_get(&header, sizeof(header));
+    if (failed || memcmp(&header, &expected, sizeof(header)) != 0)
+    {
+        fprintf(stderr, "%s: not a checkpoint of this simulator\n", path);
+        fclose(file);
+        file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+extern void checkpoint_put(const void *data, size_t size)
+{
+    if (size > 0 && fwrite(data, size, 1, file) != 1)
+        failed = 1;
+}
+
+extern void checkpoint_get(void *data, size_t size)
+{
+    if (size > 0 && fread(data, size, 1, file) != 1)
+    {
+        memset(data, 0, size);
+        failed = 1;
+    }
+}
+
+extern size_t checkpoint_left(void)
+{
+    long offset = ftell(file);
+
+    return offset >= 0 && offset < size ? (size_t)(size - offset) : 0;
+}
+
+extern int checkpoint_check(int valid)
+{
+    if (!valid)
+        failed = 1;
+    return valid;
+}
+
+extern int checkpoint_close(void)
+{
+    if (fclose(file) != 0)
+        failed = 1;
+    file = NULL;
+
+    if (writing)
+    {
+        if (!failed && rename(temp_path, final_path) != 0)
+        {
+            perror(final_path);
+            failed = 1;
+        }
+        if (failed)
+            remove(temp_path);
+    }
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,54 @@
+/*
+ * checkpoint.h
+ * Multithreaded OS Simulation - checkpoint files
+ *
+ * A checkpoint holds the simulator state at the start of a tick.  Each
+ * module writes its own part and reads it back in the same order, as raw
+ * values: a checkpoint can only be restored by a simulator built with the
+ * same layout, which the header checks.  Only one checkpoint is open at a
+ * time, and only the supervisor thread uses it.
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stddef.h>
+
+
+/*
+ * checkpoint_create() starts writing a checkpoint to path, and returns 0,
+ *   or -1 if it can't.  The checkpoint only replaces path once it is
+ *   complete, so a crash while writing it leaves the previous one intact.
+ *
+ * checkpoint_open() starts reading the checkpoint in path, and returns 0,
+ *   or -1 if it can't or path is not a checkpoint of this simulator.
+ *
+ * checkpoint_put() and checkpoint_get() write and read size bytes.  A
+ *   short read fills data with zeroes; errors are reported once, by
+ *   checkpoint_close().
+ *
+ * checkpoint_left() returns the number of bytes of the checkpoint being
+ *   read that are still to be read, so that a count read from it can be
+ *   checked before anything is allocated for it.
+ *
+ * checkpoint_check() marks the checkpoint being read as failed unless
+ *   valid, and returns valid, so that a value read out of range rejects
+ *   the checkpoint rather than being used or repaired.
+ *
+ * checkpoint_close() finishes writing or reading the checkpoint, and
+ *   returns 0, or -1 if anything failed.
+ */
+extern int checkpoint_create(const char *path);
+extern int checkpoint_open(const char *path);
+extern void checkpoint_put(const void *data, size_t size);
+extern void checkpoint_get(void *data, size_t size);
+extern size_t checkpoint_left(void);
+extern int checkpoint_check(int valid);
+extern int checkpoint_close(void);
+
+/* Write and read a variable or array of fixed size */
+#define CHECKPOINT_PUT(x) checkpoint_put(&(x), sizeof(x))
+#define CHECKPOINT_GET(x) checkpoint_get(&(x), sizeof(x))
+
+
+#endif /* __CHECKPOINT_H__ */
@@ -0,0 +1,325 @@
+/*
+ * disk.c
+ * Multithreaded OS Simulation - disk seek model and I/O schedulers
+ *
+ * See disk.h.  Only the supervisor thread serves requests, with the
+ * simulator_mutex held.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "disk.h"
+
+
+/* Blocks moved by a request; a sequential request starts where it ended */
+#define REQUEST_BLOCKS 8
+
+typedef enum {
+    SCHED_FIFO = 0,
+    SCHED_SCAN,
+    SCHED_CLOOK,
+    SCHED_DEADLINE
+} disk_scheduler_t;
+
+static const char *scheduler_names[] = { "fifo", "scan", "clook", "deadline" };
+
+static int enabled = 0;
+static disk_scheduler_t scheduler;
+
+/* Seek times, in 1/1000 ticks */
+static unsigned int full_seek, settle;
+
+
+extern int disk_init(const char *spec)
+{
+    const char *p;
+    char *end;
+    double value[2] = { 1.0, 0.1 };
+    unsigned int n;
+
+    enabled = 0;
+    if (spec == NULL)
+        return 0;
+
+    for (n=0; n<sizeof(scheduler_names) / sizeof(scheduler_names[0]); n++)
+    {
+        p = spec + strlen(scheduler_names[n]);
+        if (strncmp(spec, scheduler_names[n], p - spec) == 0 &&
+            (*p == '\0' || *p == ','))
+            break;
+    }
+    if (n == sizeof(scheduler_names) / sizeof(scheduler_names[0]))
+        return -1;
+    scheduler = (disk_scheduler_t)n;
+
+    for (n=0; n<2 && *p == ','; n++)
+    {
+        p++;
+        value[n] = strtod(p, &end);
+        if (end == p || value[n] < 0 || value[n] > 1000)
+            return -1;
+        p = end;
+    }
+    if (*p != '\0' || value[1] > value[0])
+        return -1;
+
+    full_seek = (unsigned int)(value[0] * 1000 + 0.5);
+    settle = (unsigned int)(value[1] * 1000 + 0.5);
+    enabled = 1;
+    return 0;
+}
+
+extern int disk_enabled(void)
+{
+    return enabled;
+}
+
+/*
+ * mix() is the finalizer of splitmix64, which spreads the bits of its
+ * argument over the whole result.
+ */
+static unsigned long long mix(unsigned long long x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+extern void disk_address(disk_t *disk, disk_request_t *request,
+                         unsigned int pid, int can_write)
+{
+    unsigned int region = DISK_BLOCKS / PROCESS_COUNT;
+    unsigned int base = pid * region;
+    unsigned long long h;
+
+    h = mix(((unsigned long long)pid << 32) | disk->sequence[pid]);
+    if (disk->sequence[pid] == 0 || h % 4 == 0)
+        request->block = base + (unsigned int)((h >> 8) % region);
+    else
+        request->block = disk->next_block[pid];
+    disk->next_block[pid] = base +
+        (request->block - base + REQUEST_BLOCKS) % region;
+    request->write = can_write && (h >> 40) % 10 < 3;
+    disk->sequence[pid]++;
+}
+
+/*
+ * nearest() returns the index of the request closest to the head on the
+ * side above it (or below it if up is 0), counting the head's own block on
+ * both sides, or -1 if there is none.  direction selects reads (0), writes
+ * (1) or both (-1).
+ */
+static int nearest(const disk_t *disk, disk_request_t *const *queued,
+                   unsigned int count, int up, int direction)
+{
+    unsigned int n, distance, best_distance = 0;
+    int best = -1;
+
+    for (n=0; n<count; n++)
+    {
+        if (direction >= 0 && queued[n]->write != direction)
+            continue;
+        if (up ? queued[n]->block < disk->position :
+                 queued[n]->block > disk->position)
+            continue;
+        distance = up ? queued[n]->block - disk->position :
+                        disk->position - queued[n]->block;
+        if (best < 0 || distance < best_distance)
+        {
+            best = n;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+/*
+ * lowest() returns the index of the request at the lowest block, of the
+ * given direction as for nearest(), or -1 if there is none.
+ */
+static int lowest(disk_request_t *const *queued, unsigned int count,
+                  int direction)
+{
+    unsigned int n;
+    int best = -1;
+
+    for (n=0; n<count; n++)
+        if ((direction < 0 || queued[n]->write == direction) &&
+            (best < 0 || queued[n]->block < queued[best]->block))
+            best = n;
+    return best;
+}
+
+/*
+ * pick_deadline() continues the current batch in block order while it
+ * lasts, then starts a batch of reads, unless there are none or writes have
+ * been passed over DISK_WRITES_STARVED times.  A batch starts from the
+ * oldest request of its direction if that one is past its deadline, or
+ * else from the head.
+ */
+static int pick_deadline(disk_t *disk, disk_request_t *const *queued,
+                         unsigned int count, unsigned int now)
+{
+    unsigned int n, expire;
+    int pick, oldest = -1, reads = 0, writes = 0;
+
+    if (disk->batch_left > 0)
+    {
+        pick = nearest(disk, queued, count, 1, disk->batch_write);
+        if (pick >= 0)
+        {
+            disk->batch_left--;
+            return pick;
+        }
+    }
+
+    for (n=0; n<count; n++)
+    {
+        if (queued[n]->write)
+            writes++;
+        else
+            reads++;
+    }
+    if (reads > 0 && (writes == 0 || disk->starved < DISK_WRITES_STARVED))
+    {
+        disk->batch_write = 0;
+        if (writes > 0)
+            disk->starved++;
+    }
+    else
+    {
+        disk->batch_write = 1;
+        disk->starved = 0;
+    }
+
+    /* The queue is oldest first */
+    for (n=0; n<count && oldest < 0; n++)
+        if (queued[n]->write == disk->batch_write)
+            oldest = n;
+    expire = disk->batch_write ? DISK_WRITE_EXPIRE : DISK_READ_EXPIRE;
+    if (now - queued[oldest]->submitted >= expire)
+        pick = oldest;
+    else
+    {
+        pick = nearest(disk, queued, count, 1, disk->batch_write);
+        if (pick < 0)
+            pick = lowest(queued, count, disk->batch_write);
+    }
+    disk->batch_left = DISK_FIFO_BATCH - 1;
+    return pick;
+}
+
+extern unsigned int disk_pick(disk_t *disk, disk_request_t *const *queued,
+                              unsigned int count, unsigned int now)
+{
+    int pick;
+
+    switch (scheduler)
+    {
+    case SCHED_SCAN:
+        pick = nearest(disk, queued, count, disk->rising, -1);
+        if (pick < 0)
+        {
+            disk->rising = !disk->rising;
+            pick = nearest(disk, queued, count, disk->rising, -1);
+        }
+        return pick;
+
+    case SCHED_CLOOK:
+        pick = nearest(disk, queued, count, 1, -1);
+        return pick >= 0 ? pick : lowest(queued, count, -1);
+
+    case SCHED_DEADLINE:
+        return pick_deadline(disk, queued, count, now);
+
+    default:
+        return 0;
+    }
+}
+
+extern unsigned int disk_start(disk_t *disk, const disk_request_t *request,
+                               unsigned int transfer)
+{
+    unsigned int distance, seek = 0, ticks;
+
+    distance = request->block > disk->position ?
+               request->block - disk->position :
+               disk->position - request->block;
+    if (distance > 0)
+        seek = settle + (unsigned int)((full_seek - settle) *
+               sqrt((double)distance / DISK_BLOCKS) + 0.5);
+    disk->seek_time += seek;
+
+    disk->carry += seek;
+    ticks = disk->carry / 1000;
+    disk->carry %= 1000;
+    disk->position = request->block + REQUEST_BLOCKS;
+    disk->busy_ticks += ticks + transfer;
+    return ticks + transfer;
+}
+
+extern void disk_done(disk_t *disk, const disk_request_t *request,
+                      unsigned int now)
+{
+    unsigned int latency = now - request->submitted;
+
+    disk->completed[request->write]++;
+    disk->latency_total[request->write] += latency;
+    disk->latency[request->write][latency < DISK_LATENCY_BUCKETS ?
+                                  latency : DISK_LATENCY_BUCKETS - 1]++;
+}
+
+/*
+ * print_latency() prints the distribution of the latencies of one
+ * direction.  Percentiles are nearest-rank; a latency in the last bucket is
+ * printed as at least that.
+ */
+static void print_latency(const disk_t *disk, int write)
+{
+    static const unsigned int ranks[] = { 50, 95, 99, 100 };
+    static const char *rank_names[] = { "p50", "p95", "p99", "max" };
+    unsigned int count = disk->completed[write], seen = 0, bucket = 0, n;
+
+    printf("  %-6s %6u, latency mean %.2f s", write ? "writes" : "reads",
+        count, count ? (double)disk->latency_total[write] / count / 10.0 : 0.0);
+    for (n=0; n<4 && count > 0; n++)
+    {
+        while (seen < (count * ranks[n] + 99) / 100)
+            seen += disk->latency[write][bucket++];
+        printf(", %s %s%.1f s", rank_names[n],
+            bucket == DISK_LATENCY_BUCKETS ? ">=" : "", (bucket - 1) / 10.0);
+    }
+    printf("\n");
+}
+
+extern void disk_print_stats(const disk_t *disk, const char *name,
+                             unsigned int end_time)
+{
+    unsigned int count = disk->completed[0] + disk->completed[1];
+
+    if (!enabled)
+        return;
+
+    printf("%s (%s): %u requests, %.2f per second, busy %.1f%% of the "
+        "time, %.1f%% seeking\n", name, scheduler_names[scheduler], count,
+        end_time ? count * 10.0 / end_time : 0.0,
+        end_time ? 100.0 * disk->busy_ticks / end_time : 0.0,
+        end_time ? disk->seek_time / (10.0 * end_time) : 0.0);
+    print_latency(disk, 0);
+    if (disk->completed[1] > 0)
+        print_latency(disk, 1);
+}
+
+extern void disk_save(const disk_t *disk)
+{
+    CHECKPOINT_PUT(*disk);
+}
+
+extern void disk_restore(disk_t *disk)
+{
+    CHECKPOINT_GET(*disk);
+}
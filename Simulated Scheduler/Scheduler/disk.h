@@ -0,0 +1,129 @@
+/*
+ * disk.h
+ * Multithreaded OS Simulation - disk seek model and I/O schedulers
+ *
+ * By default a device serves its requests in FIFO order, each taking the
+ * time its operation asks for.  With the disk model, each request also has
+ * a block address, and each device a head that seeks to it first:
+ *
+ *   seek(d) = settle + (full - settle) * sqrt(d / DISK_BLOCKS)
+ *
+ * for a distance of d blocks (no time for d = 0), full being the seek
+ * across the whole disk.  The model is selected with a spec string:
+ *
+ *   <scheduler>[,<full>[,<settle>]]   seek times in ticks (default 1, 0.1)
+ *
+ * and the I/O scheduler picks which queued request the device serves next:
+ *
+ *   fifo      the oldest one (the default order)
+ *   scan      the elevator: the nearest one in the direction the head is
+ *             moving, turning back at the last one (LOOK)
+ *   clook     the nearest one at or above the head, jumping back to the
+ *             lowest one at the top (C-LOOK)
+ *   deadline  batches of up to DISK_FIFO_BATCH requests of one direction
+ *             in block order, reads ahead of writes but writes at least
+ *             every DISK_WRITES_STARVED batches; a batch starts from the
+ *             oldest request if it has waited past its direction's
+ *             deadline (DISK_READ_EXPIRE or DISK_WRITE_EXPIRE ticks)
+ *
+ * The programs don't give addresses, so they are drawn from a hash of the
+ * process and the number of its requests, the same in every run: a process
+ * keeps its files in its own region of the disk, and three out of four of
+ * its requests continue where its last one ended.  Three out of ten disk
+ * requests are writes; page-ins are reads.
+ *
+ * Seek times are kept in 1/1000 ticks; each device carries the part of a
+ * tick it owes over to its next request, so that short seeks add up.
+ */
+
+#ifndef __DISK_H__
+#define __DISK_H__
+
+#include "os-sim.h"
+#include "process.h"
+
+
+#define DISK_BLOCKS (1 << 20)
+#define DISK_FIFO_BATCH 16
+#define DISK_WRITES_STARVED 2
+#define DISK_READ_EXPIRE 5
+#define DISK_WRITE_EXPIRE 50
+
+/* Latencies are counted per tick up to this, and beyond in the last one */
+#define DISK_LATENCY_BUCKETS 600
+
+typedef struct {
+    unsigned int block;
+    unsigned int submitted;
+    int write;
+} disk_request_t;
+
+/*
+ * The state of a device under the model:
+ *
+ *   position   : the block the head is at
+ *   rising     : whether the head moves up (scan)
+ *   batch_left : requests left in the current batch (deadline)
+ *   batch_write: whether the current batch is of writes
+ *   starved    : read batches since writes were last served
+ *   carry      : the part of a tick of seek time owed to the next request
+ *   next_block : where each process's next sequential request starts
+ *   sequence   : the number of requests of each process
+ */
+typedef struct {
+    unsigned int position;
+    int rising;
+    unsigned int batch_left;
+    int batch_write;
+    unsigned int starved;
+    unsigned int carry;
+    unsigned int next_block[PROCESS_COUNT];
+    unsigned int sequence[PROCESS_COUNT];
+    unsigned int completed[2];
+    unsigned long long latency_total[2];
+    unsigned int latency[2][DISK_LATENCY_BUCKETS];
+    unsigned long long seek_time;
+    unsigned long long busy_ticks;
+} disk_t;
+
+
+/*
+ * disk_init() selects the model in spec (NULL for none), and returns 0, or
+ *   -1 if spec is not valid.
+ *
+ * disk_enabled() returns 1 if the model is selected.
+ *
+ * disk_address() gives a request of process pid its block address and
+ *   direction; can_write is 0 for a device that only reads.
+ *
+ * disk_pick() returns the index of the request the device serves next,
+ *   among the count queued ones, oldest first.
+ *
+ * disk_start() returns the ticks the device takes to serve a request whose
+ *   transfer takes transfer ticks, seek included, and moves the head.
+ *
+ * disk_done() accounts a request served, in tick now.
+ *
+ * disk_print_stats() prints a device's throughput over end_time ticks and
+ *   the distribution of its latencies, from submission to completion.
+ *
+ * disk_save() and disk_restore() write a device's state to the open
+ *   checkpoint, and read it back.
+ */
+extern int disk_init(const char *spec);
+extern int disk_enabled(void);
+extern void disk_address(disk_t *disk, disk_request_t *request,
+                         unsigned int pid, int can_write);
+extern unsigned int disk_pick(disk_t *disk, disk_request_t *const *queued,
+                              unsigned int count, unsigned int now);
+extern unsigned int disk_start(disk_t *disk, const disk_request_t *request,
+                               unsigned int transfer);
+extern void disk_done(disk_t *disk, const disk_request_t *request,
+                      unsigned int now);
+extern void disk_print_stats(const disk_t *disk, const char *name,
+                             unsigned int end_time);
+extern void disk_save(const disk_t *disk);
+extern void disk_restore(disk_t *disk);
+
+
+#endif /* __DISK_H__ */
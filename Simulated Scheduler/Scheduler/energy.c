@@ -0,0 +1,65 @@
+/*
+ * energy.c
+ * Multithreaded OS Simulation - CPU power model
+ *
+ * See energy.h.  The numbers model a small core: dynamic power grows with
+ * the cube of the frequency on top of 0.5 W of static power.
+ */
+
+#include "energy.h"
+
+
+const unsigned int cpu_freq_speed[CPU_FREQ_LEVELS] = { 1000, 800, 600, 400 };
+
+static const double cpu_freq_power[CPU_FREQ_LEVELS] = { 4.0, 2.29, 1.26, 0.72 };
+
+const cstate_t cstates[CSTATE_COUNT] = {
+    { "C0", 0.5, 0, 0 },
+    { "C1", 0.3, 1, 0 },
+    { "C3", 0.1, 3, 1 },
+    { "C6", 0.02, 10, 2 }
+};
+
+unsigned int cstate_ticks[CSTATE_COUNT];
+
+
+extern double energy_busy(unsigned int level, unsigned int capacity,
+                          unsigned int ticks)
+{
+    return cpu_freq_power[level] * capacity / 1000 * ticks * TICK_SECONDS;
+}
+
+extern double energy_idle(unsigned int ticks, unsigned int cstate,
+                          unsigned int *exit_latency)
+{
+    double energy = 0.0;
+    unsigned int n, start, end;
+
+    *exit_latency = 0;
+    for (n=cstate; n<CSTATE_COUNT; n++)
+    {
+        start = n == cstate ? 0 : cstates[n].residency;
+        if (ticks <= start)
+            break;
+        end = (n + 1 < CSTATE_COUNT && cstates[n + 1].residency < ticks) ?
+              cstates[n + 1].residency : ticks;
+        energy += cstates[n].power * (end - start) * TICK_SECONDS;
+        cstate_ticks[n] += end - start;
+        *exit_latency = cstates[n].exit_latency;
+    }
+    return energy;
+}
+
+extern unsigned int busy_ticks(unsigned int speed, unsigned int work,
+                               unsigned int carry)
+{
+    if (work * 1000 <= carry)
+        return 0;
+    return (work * 1000 - carry + speed - 1) / speed;
+}
+
+extern unsigned int work_done(unsigned int speed, unsigned int ticks,
+                              unsigned int carry)
+{
+    return (ticks * speed + carry) / 1000;
+}
@@ -0,0 +1,66 @@
+/*
+ * energy.h
+ * Multithreaded OS Simulation - CPU power model
+ *
+ * Each simulated CPU runs at one of CPU_FREQ_LEVELS frequency levels (DVFS)
+ * while busy and sinks through CSTATE_COUNT idle states while idle.  Deeper
+ * idle states draw less power but are only entered after the CPU has been
+ * idle for their target residency, and cost an exit latency to wake from.
+ * A CPU given an idle state with set_idle_state() enters it at once and
+ * sinks from there.
+ *
+ * Energy is accounted per interval, when a CPU changes between busy and
+ * idle, so the model adds nothing to the cost of a tick.
+ */
+
+#ifndef __ENERGY_H__
+#define __ENERGY_H__
+
+#include "os-sim.h"
+
+
+#define CSTATE_COUNT 4
+
+/* Length of a tick, in seconds */
+#define TICK_SECONDS 0.1
+
+typedef struct {
+    const char *name;
+    double power;              /* W drawn while in this state */
+    unsigned int residency;    /* idle ticks before the state is entered */
+    unsigned int exit_latency; /* ticks to wake up from the state */
+} cstate_t;
+
+extern const cstate_t cstates[CSTATE_COUNT];
+
+/* Ticks spent in each idle state, over all CPUs */
+extern unsigned int cstate_ticks[CSTATE_COUNT];
+
+
+/*
+ * energy_busy() returns the energy in J used by a CPU of the given capacity
+ *   (see set_cpu_capacities()) running for ticks at frequency level.  A
+ *   smaller core draws power in proportion to its capacity.
+ *
+ * energy_idle() returns the energy in J used by a CPU idle for ticks,
+ *   accounts the time spent in each idle state, and stores the exit latency
+ *   of the deepest state reached.  The CPU enters cstate at once and sinks
+ *   from there.
+ *
+ * busy_ticks() returns the number of ticks needed to run work ticks (at the
+ *   fastest level of a full-capacity CPU) at speed, in 1/1000ths of that,
+ *   and work_done() the whole ticks of work done in ticks.  carry is the
+ *   work, in 1/1000 ticks, already done towards the next whole tick of work
+ *   by a burst that changed speed (see set_smt_throughput()).
+ */
+extern double energy_busy(unsigned int level, unsigned int capacity,
+                          unsigned int ticks);
+extern double energy_idle(unsigned int ticks, unsigned int cstate,
+                          unsigned int *exit_latency);
+extern unsigned int busy_ticks(unsigned int speed, unsigned int work,
+                               unsigned int carry);
+extern unsigned int work_done(unsigned int speed, unsigned int ticks,
+                              unsigned int carry);
+
+
+#endif /* __ENERGY_H__ */
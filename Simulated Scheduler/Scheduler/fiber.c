@@ -0,0 +1,210 @@
+/*
+ * fiber.c
+ * Multithreaded OS Simulation - CPUs as fibers on a pool of worker threads
+ *
+ * See fiber.h.  A fiber that waits appends itself to the condition
+ * variable's waiters and switches back to its worker still holding the
+ * waiters' lock, which the worker only releases once the fiber's context is
+ * saved; so no waker can put the fiber on the run queue, and another worker
+ * resume it, while it is still switching out.
+ *
+ * The stacks are mapped together, each below an inaccessible guard page, so
+ * that a fiber overflowing its stack crashes instead of silently writing
+ * over its neighbour's.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#include "fiber.h"
+
+
+typedef struct _worker {
+    pthread_t thread;
+    ucontext_t context;
+    pthread_mutex_t *release[2];
+} worker_t;
+
+/*
+ *   context : the fiber's registers while it is switched out
+ *   worker  : the worker running it, or that ran it last
+ *   next    : the next fiber on the run queue or the same waiters
+ */
+struct _fiber {
+    ucontext_t context;
+    unsigned int id;
+    worker_t *worker;
+    fiber_t *next;
+};
+
+static void (*fiber_func)(unsigned int);
+static pthread_mutex_t run_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t run_ready = PTHREAD_COND_INITIALIZER;
+static fiber_t *run_head = NULL, *run_tail = NULL;
+
+/* The fiber the calling worker runs; NULL on any other thread */
+static __thread fiber_t *running = NULL;
+
+
+/* run_push() puts the list of fibers from head to tail on the run queue */
+static void run_push(fiber_t *head, fiber_t *tail)
+{
+    pthread_mutex_lock(&run_lock);
+    tail->next = NULL;
+    if (run_tail == NULL)
+        run_head = head;
+    else
+        run_tail->next = head;
+    run_tail = tail;
+    if (head == tail)
+        pthread_cond_signal(&run_ready);
+    else
+        pthread_cond_broadcast(&run_ready);
+    pthread_mutex_unlock(&run_lock);
+}
+
+static void fiber_main(void)
+{
+    fiber_func(running->id);
+}
+
+static void *worker_main(void *data)
+{
+    worker_t *worker = data;
+    fiber_t *fiber;
+
+    while (1)
+    {
+        pthread_mutex_lock(&run_lock);
+        while (run_head == NULL)
+            pthread_cond_wait(&run_ready, &run_lock);
+        fiber = run_head;
+        run_head = fiber->next;
+        if (run_head == NULL)
+            run_tail = NULL;
+        pthread_mutex_unlock(&run_lock);
+
+        fiber->worker = worker;
+        running = fiber;
+        swapcontext(&worker->context, &fiber->context);
+        running = NULL;
+
+        /* The fiber waits, and its context is saved: let its wakers in */
+        pthread_mutex_unlock(worker->release[0]);
+        pthread_mutex_unlock(worker->release[1]);
+    }
+    return NULL;
+}
+
+extern void fiber_start(unsigned int workers, unsigned int count,
+                        void (*func)(unsigned int))
+{
+    worker_t *worker;
+    fiber_t *fiber;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = (FIBER_STACK_SIZE + page - 1) / page * page;
+    size_t stride = size + page;
+    char *stacks;
+    unsigned int n;
+    int guarded;
+
+    fiber_func = func;
+    fiber = calloc(count, sizeof(fiber_t));
+    worker = calloc(workers, sizeof(worker_t));
+    assert(fiber != NULL && worker != NULL);
+
+    /* Stacks grow down, so each guard page sits below its stack */
+    stacks = mmap(NULL, stride * count, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    assert(stacks != MAP_FAILED);
+
+    for (n=0; n<count; n++)
+    {
+        guarded = mprotect(stacks + n * stride, page, PROT_NONE) == 0;
+        assert(guarded);
+        fiber[n].id = n;
+        getcontext(&fiber[n].context);
+        fiber[n].context.uc_stack.ss_sp = stacks + n * stride + page;
+        fiber[n].context.uc_stack.ss_size = size;
+        fiber[n].context.uc_link = NULL;
+        makecontext(&fiber[n].context, fiber_main, 0);
+        fiber[n].next = n + 1 < count ? &fiber[n + 1] : NULL;
+    }
+    run_push(&fiber[0], &fiber[count - 1]);
+
+    for (n=0; n<workers; n++)
+        pthread_create(&worker[n].thread, NULL, worker_main, &worker[n]);
+}
+
+extern void fiber_cond_init(fiber_cond_t *cond)
+{
+    pthread_mutex_init(&cond->lock, NULL);
+    pthread_cond_init(&cond->cond, NULL);
+    cond->head = NULL;
+    cond->tail = NULL;
+}
+
+extern void fiber_cond_wait(fiber_cond_t *cond, pthread_mutex_t *mutex)
+{
+    fiber_t *self = running;
+
+    if (self == NULL)
+    {
+        pthread_cond_wait(&cond->cond, mutex);
+        return;
+    }
+
+    pthread_mutex_lock(&cond->lock);
+    self->next = NULL;
+    if (cond->tail == NULL)
+        cond->head = self;
+    else
+        cond->tail->next = self;
+    cond->tail = self;
+
+    /* The worker releases both locks once it has switched */
+    self->worker->release[0] = &cond->lock;
+    self->worker->release[1] = mutex;
+    swapcontext(&self->context, &self->worker->context);
+
+    /* Resumed, maybe by another worker */
+    pthread_mutex_lock(mutex);
+}
+
+extern void fiber_cond_signal(fiber_cond_t *cond)
+{
+    fiber_t *fiber;
+
+    pthread_mutex_lock(&cond->lock);
+    fiber = cond->head;
+    if (fiber != NULL)
+    {
+        cond->head = fiber->next;
+        if (cond->head == NULL)
+            cond->tail = NULL;
+    }
+    pthread_mutex_unlock(&cond->lock);
+
+    if (fiber != NULL)
+        run_push(fiber, fiber);
+    pthread_cond_signal(&cond->cond);
+}
+
+extern void fiber_cond_broadcast(fiber_cond_t *cond)
+{
+    fiber_t *head, *tail;
+
+    pthread_mutex_lock(&cond->lock);
+    head = cond->head;
+    tail = cond->tail;
+    cond->head = NULL;
+    cond->tail = NULL;
+    pthread_mutex_unlock(&cond->lock);
+
+    if (head != NULL)
+        run_push(head, tail);
+    pthread_cond_broadcast(&cond->cond);
+}
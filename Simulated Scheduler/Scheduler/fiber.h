@@ -0,0 +1,66 @@
+/*
+ * fiber.h
+ * Multithreaded OS Simulation - CPUs as fibers on a pool of worker threads
+ *
+ * By default every simulated CPU has a thread of its own, which sleeps in
+ * the kernel between events.  In M:N mode every CPU is a fiber instead: a
+ * context with a stack of its own, run by whichever of a small pool of
+ * worker threads is free.  A fiber that waits is switched out in user
+ * space, and handing it an event only puts it on the run queue, so a
+ * waiting CPU costs a stack rather than a kernel thread.  The workers run
+ * fibers in parallel, so the handlers still run concurrently.
+ *
+ * Fibers are not preempted: a fiber keeps its worker until it waits on a
+ * fiber_cond_t, which is the only way code run on a fiber may block.  A
+ * mutex may be taken on a fiber, as its holder is always running, but no
+ * mutex may be held across a wait other than the one waited with.
+ *
+ * fiber_cond_t is a condition variable that threads and fibers may both
+ * wait on; a waiter may be woken up spuriously, as with pthreads.
+ */
+
+#ifndef __FIBER_H__
+#define __FIBER_H__
+
+#include <pthread.h>
+
+
+/* Stack size of a fiber, in bytes, rounded up to whole pages */
+#define FIBER_STACK_SIZE (64 * 1024)
+
+typedef struct _fiber fiber_t;
+
+/*
+ *   lock        : protects the fiber waiters, and is held by a fiber that
+ *                 waits until it has been switched out
+ *   cond        : the threads waiting
+ *   head, tail  : the fibers waiting, oldest first
+ */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    fiber_t *head, *tail;
+} fiber_cond_t;
+
+
+/*
+ * fiber_start() starts count fibers, the n-th running func(n), which must
+ *   not return, on workers worker threads, and returns.
+ *
+ * fiber_cond_init() initializes a condition variable.
+ *
+ * fiber_cond_wait() releases mutex and waits until the condition variable
+ *   is signalled, then takes mutex again, on a thread or on a fiber.
+ *
+ * fiber_cond_signal() wakes up at least one waiter, and
+ *   fiber_cond_broadcast() every waiter.
+ */
+extern void fiber_start(unsigned int workers, unsigned int count,
+                        void (*func)(unsigned int));
+extern void fiber_cond_init(fiber_cond_t *cond);
+extern void fiber_cond_wait(fiber_cond_t *cond, pthread_mutex_t *mutex);
+extern void fiber_cond_signal(fiber_cond_t *cond);
+extern void fiber_cond_broadcast(fiber_cond_t *cond);
+
+
+#endif /* __FIBER_H__ */
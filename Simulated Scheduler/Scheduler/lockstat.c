@@ -0,0 +1,161 @@
+/*
+ * lockstat.c
+ * Multithreaded OS Simulation - lock contention instrumentation
+ *
+ * See lockstat.h.  This file is empty unless LOCKSTAT is defined.
+ */
+
+#include "lockstat.h"
+
+#ifdef LOCKSTAT
+
+#include <stdio.h>
+#include <time.h>
+
+static lockstat_t *lockstat_list = NULL;
+static pthread_mutex_t lockstat_list_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static unsigned int lockstat_bucket(unsigned long long ns)
+{
+    unsigned int bucket = 0;
+
+    while (ns != 0 && bucket < LOCKSTAT_BUCKETS - 1)
+    {
+        ns >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+extern void lockstat_register(lockstat_t *stat, const char *name)
+{
+    unsigned int n;
+
+    stat->name = name;
+    stat->acquisitions = 0;
+    stat->contended = 0;
+    for (n=0; n<LOCKSTAT_BUCKETS; n++)
+    {
+        stat->wait_hist[n] = 0;
+        stat->hold_hist[n] = 0;
+    }
+
+    pthread_mutex_lock(&lockstat_list_mutex);
+    stat->next = lockstat_list;
+    lockstat_list = stat;
+    pthread_mutex_unlock(&lockstat_list_mutex);
+}
+
+extern unsigned long long lockstat_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+extern void lockstat_acquired(lockstat_t *stat, unsigned long long start,
+                              int contended)
+{
+    stat->acquisitions++;
+    if (contended)
+        stat->contended++;
+    stat->wait_hist[lockstat_bucket(lockstat_now() - start)]++;
+}
+
+extern void lockstat_held(lockstat_t *stat, unsigned long long start)
+{
+    stat->hold_hist[lockstat_bucket(lockstat_now() - start)]++;
+}
+
+
+/*
+ * A try-lock first tells us whether the acquisition is contended without
+ * paying for a timestamp on the wait side when it is not.
+ */
+extern void lockstat_mutex_init(lockstat_mutex_t *m, const char *name)
+{
+    pthread_mutex_init(&m->mutex, NULL);
+    lockstat_register(&m->stat, name);
+}
+
+extern void lockstat_mutex_lock(lockstat_mutex_t *m)
+{
+    unsigned long long start;
+
+    if (pthread_mutex_trylock(&m->mutex) == 0)
+    {
+        m->stat.acquisitions++;
+        m->stat.wait_hist[0]++;
+        m->acquired_at = lockstat_now();
+        return;
+    }
+
+    start = lockstat_now();
+    pthread_mutex_lock(&m->mutex);
+    lockstat_acquired(&m->stat, start, 1);
+    m->acquired_at = lockstat_now();
+}
+
+extern void lockstat_mutex_unlock(lockstat_mutex_t *m)
+{
+    lockstat_held(&m->stat, m->acquired_at);
+    pthread_mutex_unlock(&m->mutex);
+}
+
+/*
+ * Waiting on a condition variable ends the current critical section.  The
+ * time spent blocked is waiting for an event, not for the lock, so it is not
+ * counted as a (contended) acquisition.
+ */
+extern void lockstat_cond_wait(fiber_cond_t *c, lockstat_mutex_t *m)
+{
+    lockstat_held(&m->stat, m->acquired_at);
+    fiber_cond_wait(c, &m->mutex);
+    m->acquired_at = lockstat_now();
+}
+
+
+static void lockstat_print_hist(const char *label, unsigned long *hist)
+{
+    unsigned int n;
+    int empty = 1;
+
+    printf("    %-5s", label);
+    for (n=0; n<LOCKSTAT_BUCKETS; n++)
+    {
+        if (hist[n] == 0)
+            continue;
+        empty = 0;
+        if (n == 0)
+            printf(" <1ns:%lu", hist[n]);
+        else if (n <= 10)
+            printf(" <%lluns:%lu", 1ULL << n, hist[n]);
+        else if (n <= 20)
+            printf(" <%lluus:%lu", (1ULL << n) / 1000, hist[n]);
+        else
+            printf(" <%llums:%lu", (1ULL << n) / 1000000, hist[n]);
+    }
+    printf(empty ? " -\n" : "\n");
+}
+
+extern void lockstat_dump(void)
+{
+    lockstat_t *stat;
+
+    printf("\nLock statistics:\n");
+    pthread_mutex_lock(&lockstat_list_mutex);
+    for (stat = lockstat_list; stat != NULL; stat = stat->next)
+    {
+        printf("  %-20s acquisitions: %-8lu contended: %lu (%.1f%%)\n",
+            stat->name, stat->acquisitions, stat->contended,
+            stat->acquisitions ?
+                100.0 * stat->contended / stat->acquisitions : 0.0);
+        lockstat_print_hist("wait", stat->wait_hist);
+        lockstat_print_hist("hold", stat->hold_hist);
+    }
+    pthread_mutex_unlock(&lockstat_list_mutex);
+}
+
+#endif /* LOCKSTAT */
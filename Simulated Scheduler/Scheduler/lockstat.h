@@ -0,0 +1,84 @@
+/*
+ * lockstat.h
+ * Multithreaded OS Simulation - lock contention instrumentation
+ *
+ * lockstat_mutex_t wraps a pthread mutex and records, per lock, the number
+ * of acquisitions, how many of them were contended, and log2 histograms of
+ * the time spent waiting for and holding the lock.  lockstat_dump() prints
+ * every registered lock.
+ *
+ * The instrumentation is only compiled in when LOCKSTAT is defined
+ * (make defs=-DLOCKSTAT).  Otherwise lockstat_mutex_t is a plain
+ * pthread_mutex_t and every macro below expands to the matching pthread call,
+ * or fiber_cond_wait() for a wait, which fibers may call too (see fiber.h).
+ */
+
+#ifndef __LOCKSTAT_H__
+#define __LOCKSTAT_H__
+
+#include <pthread.h>
+
+#include "fiber.h"
+
+
+#ifdef LOCKSTAT
+
+/* Histogram bucket n counts samples in [2^(n-1), 2^n) nanoseconds */
+#define LOCKSTAT_BUCKETS 32
+
+typedef struct _lockstat_t {
+    const char *name;
+    unsigned long acquisitions;
+    unsigned long contended;
+    unsigned long wait_hist[LOCKSTAT_BUCKETS];
+    unsigned long hold_hist[LOCKSTAT_BUCKETS];
+    struct _lockstat_t *next;
+} lockstat_t;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    lockstat_t stat;
+    unsigned long long acquired_at;
+} lockstat_mutex_t;
+
+/*
+ * The counters of a lockstat_t are only updated while the lock it describes
+ * is held, so they need no synchronization of their own.
+ *
+ *   lockstat_register() : adds a lockstat_t to the list printed by
+ *                         lockstat_dump()
+ *   lockstat_now()      : a monotonic timestamp in nanoseconds
+ *   lockstat_acquired() : records an acquisition that started at start
+ *   lockstat_held()     : records a critical section that started at start
+ */
+extern void lockstat_register(lockstat_t *stat, const char *name);
+extern unsigned long long lockstat_now(void);
+extern void lockstat_acquired(lockstat_t *stat, unsigned long long start,
+                              int contended);
+extern void lockstat_held(lockstat_t *stat, unsigned long long start);
+extern void lockstat_dump(void);
+
+extern void lockstat_mutex_init(lockstat_mutex_t *m, const char *name);
+extern void lockstat_mutex_lock(lockstat_mutex_t *m);
+extern void lockstat_mutex_unlock(lockstat_mutex_t *m);
+extern void lockstat_cond_wait(fiber_cond_t *c, lockstat_mutex_t *m);
+
+#define LOCKSTAT_MUTEX_INIT(m, name) lockstat_mutex_init((m), (name))
+#define LOCKSTAT_MUTEX_LOCK(m) lockstat_mutex_lock(m)
+#define LOCKSTAT_MUTEX_UNLOCK(m) lockstat_mutex_unlock(m)
+#define LOCKSTAT_COND_WAIT(c, m) lockstat_cond_wait((c), (m))
+
+#else /* !LOCKSTAT */
+
+typedef pthread_mutex_t lockstat_mutex_t;
+
+#define LOCKSTAT_MUTEX_INIT(m, name) pthread_mutex_init((m), NULL)
+#define LOCKSTAT_MUTEX_LOCK(m) pthread_mutex_lock(m)
+#define LOCKSTAT_MUTEX_UNLOCK(m) pthread_mutex_unlock(m)
+#define LOCKSTAT_COND_WAIT(c, m) fiber_cond_wait((c), (m))
+#define lockstat_dump()
+
+#endif /* LOCKSTAT */
+
+
+#endif /* __LOCKSTAT_H__ */
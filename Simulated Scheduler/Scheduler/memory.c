@@ -0,0 +1,258 @@
+/*
+ * memory.c
+ * Multithreaded OS Simulation - paged memory model
+ *
+ * See memory.h.  Everything here is only called by the simulator with the
+ * simulator_mutex held.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "checkpoint.h"
+#include "memory.h"
+#include "process.h"
+
+
+/*
+ * A frame of physical memory, holding page of process pid, or free if pid
+ * is -1.  referenced is the bit the clock hand clears as it sweeps by.
+ */
+typedef struct {
+    int pid;
+    unsigned int page;
+    int referenced;
+} frame_t;
+
+static frame_t *frames;
+static unsigned int frame_count = 0;
+static unsigned int *free_frames;
+static unsigned int free_count = 0;
+static unsigned int clock_hand = 0;
+
+/* The frame holding each page of each process, -1 if not resident */
+static int page_frame[PROCESS_COUNT][MAX_WORKING_SET];
+
+/* Whether each page was evicted since it was last loaded */
+static char page_evicted[PROCESS_COUNT][MAX_WORKING_SET];
+
+static unsigned int working_set[PROCESS_COUNT];
+static unsigned int faults[PROCESS_COUNT];
+static unsigned int refaults = 0, evictions = 0;
+
+
+extern void memory_init(unsigned int frame_total)
+{
+    unsigned int n, p;
+
+    frame_count = frame_total;
+    if (frame_count == 0)
+        return;
+
+    frames = malloc(sizeof(frame_t) * frame_count);
+    free_frames = malloc(sizeof(unsigned int) * frame_count);
+    assert(frames != NULL && free_frames != NULL);
+    for (n=0; n<frame_count; n++)
+    {
+        frames[n].pid = -1;
+        free_frames[n] = frame_count - 1 - n;
+    }
+    free_count = frame_count;
+
+    for (n=0; n<PROCESS_COUNT; n++)
+        for (p=0; p<MAX_WORKING_SET; p++)
+            page_frame[n][p] = -1;
+}
+
+extern int memory_enabled(void)
+{
+    return frame_count > 0;
+}
+
+extern void memory_set_working_set(unsigned int pid, unsigned int pages)
+{
+    assert(pid < PROCESS_COUNT);
+    assert(pages <= MAX_WORKING_SET);
+
+    if (pages > frame_count)
+        pages = frame_count;
+    working_set[pid] = pages;
+}
+
+extern unsigned int memory_touch(unsigned int pid)
+{
+    unsigned int page, missing = 0;
+
+    for (page=0; page<working_set[pid]; page++)
+    {
+        if (page_frame[pid][page] < 0)
+            missing++;
+        else
+            frames[page_frame[pid][page]].referenced = 1;
+    }
+    return missing;
+}
+
+/*
+ * clock_victim() returns a free frame, or else evicts the page the clock
+ * hand stops at: the first one not referenced since the hand last went by.
+ * The pages of pid's working set are passed over, so that loading a working
+ * set never evicts part of itself.
+ */
+static unsigned int clock_victim(unsigned int pid)
+{
+    frame_t *f;
+    unsigned int victim;
+
+    if (free_count > 0)
+        return free_frames[--free_count];
+
+    while (1)
+    {
+        f = &frames[clock_hand];
+        victim = clock_hand;
+        clock_hand = (clock_hand + 1) % frame_count;
+
+        if (f->pid == (int)pid && f->page < working_set[pid])
+            continue;
+        if (f->referenced)
+        {
+            f->referenced = 0;
+            continue;
+        }
+
+        page_frame[f->pid][f->page] = -1;
+        page_evicted[f->pid][f->page] = 1;
+        evictions++;
+        return victim;
+    }
+}
+
+extern void memory_load(unsigned int pid)
+{
+    unsigned int page, frame;
+
+    for (page=0; page<working_set[pid]; page++)
+    {
+        if (page_frame[pid][page] >= 0)
+            continue;
+
+        frame = clock_victim(pid);
+        frames[frame].pid = pid;
+        frames[frame].page = page;
+        frames[frame].referenced = 1;
+        page_frame[pid][page] = frame;
+
+        faults[pid]++;
+        if (page_evicted[pid][page])
+        {
+            refaults++;
+            page_evicted[pid][page] = 0;
+        }
+    }
+}
+
+extern void memory_release(unsigned int pid)
+{
+    unsigned int page;
+    int frame;
+
+    if (frame_count == 0)
+        return;
+
+    for (page=0; page<MAX_WORKING_SET; page++)
+    {
+        frame = page_frame[pid][page];
+        if (frame < 0)
+            continue;
+        frames[frame].pid = -1;
+        free_frames[free_count++] = frame;
+        page_frame[pid][page] = -1;
+    }
+}
+
+/*
+ * A page faulted in again after being evicted is a refault: a high share of
+ * refaults means the working sets of the running processes don't fit and
+ * the system is thrashing.
+ */
+extern void memory_print_stats(unsigned int end_time)
+{
+    unsigned int n, total = 0;
+
+    if (frame_count == 0)
+        return;
+
+    for (n=0; n<PROCESS_COUNT; n++)
+        total += faults[n];
+
+    printf("Page faults: %u (%.1f per s), %u refaults, %u pages evicted, "
+        "%u frames\n", total, end_time ? total * 10.0 / end_time : 0.0,
+        refaults, evictions, frame_count);
+    printf("\nProcess    Working set    Page faults\n");
+    for (n=0; n<PROCESS_COUNT; n++)
+        printf("%-10s %11u %14u\n", processes[n].name, working_set[n],
+            faults[n]);
+}
+
+extern void memory_save(void)
+{
+    CHECKPOINT_PUT(frame_count);
+    if (frame_count == 0)
+        return;
+
+    checkpoint_put(frames, sizeof(frame_t) * frame_count);
+    CHECKPOINT_PUT(free_count);
+    checkpoint_put(free_frames, sizeof(unsigned int) * free_count);
+    CHECKPOINT_PUT(clock_hand);
+    CHECKPOINT_PUT(page_frame);
+    CHECKPOINT_PUT(page_evicted);
+    CHECKPOINT_PUT(working_set);
+    CHECKPOINT_PUT(faults);
+    CHECKPOINT_PUT(refaults);
+    CHECKPOINT_PUT(evictions);
+}
+
+extern void memory_restore(void)
+{
+    unsigned int saved_count, n, p;
+
+    CHECKPOINT_GET(saved_count);
+    if (!checkpoint_check(saved_count <= checkpoint_left() / sizeof(frame_t)))
+        saved_count = 0;
+    if (frame_count > 0)
+    {
+        free(frames);
+        free(free_frames);
+    }
+    memory_init(saved_count);
+    if (frame_count == 0)
+        return;
+
+    checkpoint_get(frames, sizeof(frame_t) * frame_count);
+    for (n=0; n<frame_count; n++)
+        checkpoint_check(frames[n].pid >= -1 &&
+                         frames[n].pid < PROCESS_COUNT &&
+                         frames[n].page < MAX_WORKING_SET);
+    CHECKPOINT_GET(free_count);
+    if (!checkpoint_check(free_count <= frame_count))
+        free_count = 0;
+    checkpoint_get(free_frames, sizeof(unsigned int) * free_count);
+    for (n=0; n<free_count; n++)
+        checkpoint_check(free_frames[n] < frame_count);
+    CHECKPOINT_GET(clock_hand);
+    checkpoint_check(clock_hand < frame_count);
+    CHECKPOINT_GET(page_frame);
+    for (n=0; n<PROCESS_COUNT; n++)
+        for (p=0; p<MAX_WORKING_SET; p++)
+            checkpoint_check(page_frame[n][p] >= -1 &&
+                             page_frame[n][p] < (int)frame_count);
+    CHECKPOINT_GET(page_evicted);
+    CHECKPOINT_GET(working_set);
+    for (n=0; n<PROCESS_COUNT; n++)
+        checkpoint_check(working_set[n] <= MAX_WORKING_SET);
+    CHECKPOINT_GET(faults);
+    CHECKPOINT_GET(refaults);
+    CHECKPOINT_GET(evictions);
+}
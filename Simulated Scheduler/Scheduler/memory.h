@@ -0,0 +1,64 @@
+/*
+ * memory.h
+ * Multithreaded OS Simulation - paged memory model
+ *
+ * Physical memory is a pool of frames shared by all processes.  An OP_MEM
+ * operation sets the working set of a process: the pages its following CPU
+ * bursts touch.  Every page of the working set must be resident when the
+ * process is dispatched; the missing ones are page faults, which the
+ * simulator turns into a request on the paging device.  When the request
+ * completes, the pages are loaded, evicting other pages picked by the clock
+ * (second chance) approximation of LRU.
+ *
+ * The memory model is on only once set_memory_frames() has been called.
+ * While it is off, OP_MEM operations are skipped and every page is always
+ * resident.
+ */
+
+#ifndef __MEMORY_H__
+#define __MEMORY_H__
+
+#include "os-sim.h"
+
+
+/* Largest working set a process can declare, in pages */
+#define MAX_WORKING_SET 64
+
+/* Pages the paging device transfers in one tick */
+#define PAGES_PER_TICK 8
+
+
+/*
+ * memory_init() sets up a pool of frames.  A pool of 0 frames turns the
+ *   memory model off.
+ *
+ * memory_enabled() returns whether the memory model is on.
+ *
+ * memory_set_working_set() applies an OP_MEM operation of a process.  A
+ *   working set larger than physical memory is cut down to it.
+ *
+ * memory_touch() marks the resident pages of a process's working set as
+ *   referenced, and returns the number of pages that are not resident.
+ *
+ * memory_load() makes a process's whole working set resident.
+ *
+ * memory_release() frees the frames of a process that terminated.
+ *
+ * memory_print_stats() prints the paging statistics.
+ *
+ * memory_save() writes the state of memory to the open checkpoint, and
+ *   memory_restore() replaces it with the state read back, frame pool
+ *   included.
+ */
+extern void memory_init(unsigned int frames);
+extern int memory_enabled(void);
+extern void memory_set_working_set(unsigned int pid, unsigned int pages);
+extern unsigned int memory_touch(unsigned int pid);
+extern void memory_load(unsigned int pid);
+extern void memory_release(unsigned int pid);
+extern void memory_print_stats(unsigned int end_time);
+extern void memory_save(void);
+extern void memory_restore(void);
+
+
+#endif /* __MEMORY_H__ */
@@ -0,0 +1,77 @@
+/*
+ * metrics.c
+ * Multithreaded OS Simulation - live metrics in shared memory
+ *
+ * See metrics.h.  Only the supervisor thread publishes.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+
+static metrics_segment_t *segment = NULL;
+static char segment_name[256];
+
+
+extern int metrics_open(const char *name)
+{
+    int fd;
+
+    fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror(name);
+        return -1;
+    }
+    if (ftruncate(fd, sizeof(metrics_segment_t)) != 0)
+    {
+        perror(name);
+        close(fd);
+        return -1;
+    }
+    segment = mmap(NULL, sizeof(metrics_segment_t), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED)
+    {
+        perror(name);
+        segment = NULL;
+        return -1;
+    }
+
+    strncpy(segment_name, name, sizeof(segment_name) - 1);
+    memset(&segment->metrics, 0, sizeof(metrics_t));
+    segment->sequence = 0;
+    segment->pid = getpid();
+    __atomic_store_n(&segment->magic, METRICS_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+extern void metrics_publish(const metrics_t *m)
+{
+    const uint64_t *from = (const uint64_t*)m;
+    uint64_t *to, sequence;
+    unsigned int n;
+
+    if (segment == NULL)
+        return;
+
+    to = (uint64_t*)&segment->metrics;
+    sequence = segment->sequence;
+    __atomic_store_n(&segment->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (n=0; n<sizeof(metrics_t) / sizeof(uint64_t); n++)
+        __atomic_store_n(&to[n], from[n], __ATOMIC_RELAXED);
+    __atomic_store_n(&segment->sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+extern void metrics_close(void)
+{
+    if (segment != NULL)
+        shm_unlink(segment_name);
+}
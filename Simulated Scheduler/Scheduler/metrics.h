@@ -0,0 +1,66 @@
+/*
+ * metrics.h
+ * Multithreaded OS Simulation - live metrics in shared memory
+ *
+ * The simulator publishes its counters once a tick in a POSIX shared memory
+ * object, which os-stat (or any other reader) can map and poll while the
+ * simulation runs.  The counters are guarded by a sequence lock: the
+ * simulator makes the sequence odd while it updates them, and even again
+ * when done, so it never waits for a reader; a reader retries whenever it
+ * sees an odd sequence, or a different one after copying the counters.
+ *
+ * A simulator that is killed never sets finished, so a reader also gives up
+ * once the simulator's pid is gone, or its simulator_time stops moving.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stdint.h>
+
+
+#define METRICS_MAGIC 0x6f7373696d6d6574ULL /* "ossimmet" */
+#define METRICS_MAX_CPUS 64
+
+/*
+ * Every field is 64 bits, so that a reader can copy them one by one.
+ * Counters only grow; rates are left to the reader, apart from ticks per
+ * wall-clock second, which the simulator measures over the last second.
+ */
+typedef struct {
+    uint64_t simulator_time;       /* ticks simulated */
+    uint64_t ticks_per_second;     /* ticks simulated in the last second */
+    uint64_t wall_ns;              /* wall-clock time of the update */
+    uint64_t finished;             /* 1 once the simulation has ended */
+    uint64_t context_switches;
+    uint64_t new, ready, running, waiting, terminated;
+    uint64_t io_queue;             /* requests queued on the disk */
+    uint64_t paging_queue;         /* requests queued on the paging device */
+    uint64_t cpu_count;
+    uint64_t cpu_busy[METRICS_MAX_CPUS]; /* ticks each CPU ran a process */
+} metrics_t;
+
+typedef struct {
+    uint64_t magic;
+    uint64_t sequence;
+    uint64_t pid;                  /* the simulator's process */
+    metrics_t metrics;
+} metrics_segment_t;
+
+
+/*
+ * metrics_open() creates the shared memory object name (e.g. "/os-sim"),
+ *   and returns 0, or -1 if it can't.
+ *
+ * metrics_publish() copies m into the shared memory object.  It never
+ *   blocks, and does nothing if metrics_open() was not called.
+ *
+ * metrics_close() removes the name of the shared memory object; readers
+ *   that have it mapped keep the last counters published.
+ */
+extern int metrics_open(const char *name);
+extern void metrics_publish(const metrics_t *m);
+extern void metrics_close(void);
+
+
+#endif /* __METRICS_H__ */
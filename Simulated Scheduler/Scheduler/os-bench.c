@@ -0,0 +1,701 @@
+/*
+ * os-bench.c
+ * Multithreaded OS Simulation - scheduler regression benchmark
+ *
+ * Runs ./os-sim over a fixed matrix of schedulers, CPU counts and
+ * workloads, and records for each run the simulated metrics (context
+ * switches, execution time, time spent READY) and the wall-clock time:
+ *
+ *   ./os-bench [ -o <results> | -B <baseline> ] [ -b <baseline> ]
+ *              [ -l <results> ] [ -n <runs> ] [ -s <percent> ]
+ *              [ -w <percent> ]
+ *   ./os-bench -c <processes>
+ *   ./os-bench -t <ticks>
+ *
+ *   -o  the CSV file the results go to (default stdout)
+ *   -B  the CSV file the results go to as a baseline to commit, without
+ *       the wall-clock times
+ *   -b  a CSV file of earlier results to compare with; os-bench exits with
+ *       1 if a metric is worse than in the baseline by more than the
+ *       tolerance, or a run failed
+ *   -l  a CSV file of earlier results recorded with -o on this machine,
+ *       to compare the wall-clock times with
+ *   -n  the runs of each configuration (default 5)
+ *   -s  the tolerance of the simulated metrics (default 10%)
+ *   -w  the tolerance of the wall-clock time (default 50%)
+ *   -c  instead of the matrix, time how long counting the processes in
+ *       each state takes per tick with that many processes
+ *   -t  instead of the matrix, record a synthetic timeline of that many
+ *       ticks on TIMELINE_CPUS CPUs, and time each view ./os-timeline has
+ *       of it
+ *
+ * Runs on several CPUs vary with the threads' timing, some by a lot, so
+ * each metric is recorded as the median of the runs and the worst run.  A
+ * metric regresses if its median is worse by more than the tolerance than
+ * the baseline's worst run plus its spread (worst - median) again, so that
+ * a configuration is held to its own noise on top of the tolerance: a
+ * deterministic one, on a single CPU, has no spread, and is held to its
+ * exact value plus the tolerance.  Every metric is worse when higher.  A
+ * metric also has to be worse than the baseline's median by more than a
+ * floor (a few switches, a few ticks, a few ms) to count, so that small
+ * values don't fail on noise.  Wall-clock times only compare with a
+ * baseline recorded on the same machine and build, so a baseline written
+ * with -B leaves them out, and -b compares only the metrics its baseline
+ * has; -l gives the results of an earlier local run to compare them with.
+ *
+ * A run that fails, or is still running after RUN_TIMEOUT seconds, as a
+ * simulator that livelocks would be, is killed and counts as a regression;
+ * its configuration is left out of the results.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "os-sim.h"
+#include "process.h"
+#include "timeline.h"
+
+
+#define MAX_ARGS 16
+#define MAX_RUNS 15
+#define MAX_RESULTS 256
+
+/* Seconds a run may take; the slowest configurations take well under one */
+#define RUN_TIMEOUT 30
+
+/* Ticks timed by bench_states(); reading the counters needs many more */
+#define SCAN_TICKS 100
+#define COUNTER_TICKS 10000000
+
+/* The synthetic timeline bench_timeline() records */
+#define TIMELINE_FILE "bench-timeline.bin"
+#define TIMELINE_CPUS 16
+
+/* The minimum number of CPUs is 2 for the Gang scheduler's groups */
+typedef struct {
+    const char *name;
+    const char *args;
+    unsigned int min_cpus;
+} scheduler_t;
+
+typedef struct {
+    const char *name;
+    const char *args;
+} workload_t;
+
+static const scheduler_t schedulers[] = {
+    { "fcfs", "", 1 },
+    { "rr", "-r 4", 1 },
+    { "rr-short", "-r 1", 1 },
+    { "sp", "-p", 1 },
+    { "adaptive", "-a", 1 },
+    { "classify", "-b 4", 1 },
+    { "fairshare", "-c 4", 1 },
+    { "gang", "-G 4", 2 },
+    { "capacity", "-H 4", 1 },
+};
+
+static const unsigned int cpu_counts[] = { 1, 2, 4, 16 };
+
+static const workload_t workloads[] = {
+    { "fixed", "" },
+    { "poisson", "-w poisson:0.5 -s 7" },
+    { "paging", "-m 40" },
+    { "disk", "-D clook" },
+    { "locks", "-k" },
+    { "asym", "-C 300,1000" },
+    { "smt", "-S 400" },
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+enum {
+    METRIC_SWITCHES = 0,
+    METRIC_EXECUTION,
+    METRIC_READY,
+    METRIC_WALL,
+    METRIC_COUNT
+};
+
+static const char *metric_names[METRIC_COUNT] = {
+    "context_switches", "execution_ticks", "ready_ticks", "wall_ms"
+};
+
+/* The least a metric must worsen by to count as a regression */
+static const double metric_floors[METRIC_COUNT] = { 10, 10, 50, 20 };
+
+typedef struct {
+    char id[64];
+    double value[METRIC_COUNT];
+    double worst[METRIC_COUNT];
+} result_t;
+
+
+/* The simulator run_sim() waits for, killed if it runs out of time */
+static volatile pid_t running_pid;
+static volatile sig_atomic_t timed_out;
+
+static void run_timeout(int signal)
+{
+    timed_out = 1;
+    kill(running_pid, SIGKILL);
+}
+
+/*
+ * run_sim() runs ./os-sim with the arguments in args once, and stores its
+ * metrics; it returns -1 if the simulator failed or ran out of time.  Times
+ * are read in seconds with one decimal, and kept in ticks.
+ */
+static int run_sim(const char *args, double *value)
+{
+    char buffer[256], line[512], *argv[MAX_ARGS + 2], *token;
+    struct timespec start, end;
+    unsigned int argc = 0, found = 0;
+    int fds[2], status;
+    double seconds;
+    pid_t pid;
+    FILE *out;
+
+    snprintf(buffer, sizeof(buffer), "%s", args);
+    argv[argc++] = "./os-sim";
+    for (token = strtok(buffer, " "); token != NULL && argc <= MAX_ARGS;
+         token = strtok(NULL, " "))
+        argv[argc++] = token;
+    argv[argc] = NULL;
+
+    if (pipe(fds) < 0)
+        return -1;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+    {
+        dup2(fds[1], STDOUT_FILENO);
+        close(fds[0]);
+        close(fds[1]);
+        freopen("/dev/null", "w", stderr);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    close(fds[1]);
+
+    /* A simulator that hangs keeps the pipe open until it is killed */
+    running_pid = pid;
+    signal(SIGALRM, run_timeout);
+    alarm(RUN_TIMEOUT);
+    out = fdopen(fds[0], "r");
+    while (fgets(line, sizeof(line), out) != NULL)
+    {
+        if (sscanf(line, "# of Context Switches: %lf",
+                   &value[METRIC_SWITCHES]) == 1)
+            found |= 1 << METRIC_SWITCHES;
+        else if (sscanf(line, "Total execution time: %lf s", &seconds) == 1)
+        {
+            value[METRIC_EXECUTION] = seconds * 10;
+            found |= 1 << METRIC_EXECUTION;
+        }
+        else if (sscanf(line, "Total time spent in READY state: %lf s",
+                        &seconds) == 1)
+        {
+            value[METRIC_READY] = seconds * 10;
+            found |= 1 << METRIC_READY;
+        }
+    }
+    fclose(out);
+    waitpid(pid, &status, 0);
+    alarm(0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    value[METRIC_WALL] = (end.tv_sec - start.tv_sec) * 1000.0 +
+                         (end.tv_nsec - start.tv_nsec) / 1000000.0;
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 ||
+        found != (1 << METRIC_WALL) - 1)
+        return -1;
+    return 0;
+}
+
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+
+    return x < y ? -1 : x > y;
+}
+
+/*
+ * run_config() runs a configuration runs times, and stores the median and
+ * the worst of each metric in result; it returns -1 if any run failed.
+ */
+static int run_config(const char *args, unsigned int runs, result_t *result)
+{
+    double samples[METRIC_COUNT][MAX_RUNS], value[METRIC_COUNT];
+    unsigned int n, m;
+
+    for (n=0; n<runs; n++)
+    {
+        if (run_sim(args, value) < 0)
+            return -1;
+        for (m=0; m<METRIC_COUNT; m++)
+            samples[m][n] = value[m];
+    }
+    for (m=0; m<METRIC_COUNT; m++)
+    {
+        qsort(samples[m], runs, sizeof(double), compare_doubles);
+        result->value[m] = runs % 2 ? samples[m][runs / 2] :
+            (samples[m][runs / 2 - 1] + samples[m][runs / 2]) / 2;
+        result->worst[m] = samples[m][runs - 1];
+    }
+    return 0;
+}
+
+/*
+ * read_baseline() reads the results in the CSV file path, as written by
+ * write_results(), and returns their number, or -1 if it can't be read.
+ * The wall-clock time of a baseline that has none is -1.
+ */
+static int read_baseline(const char *path, result_t *baseline)
+{
+    char line[512], *p, *end;
+    unsigned int count = 0, m;
+    FILE *in;
+
+    in = fopen(path, "r");
+    if (in == NULL)
+        return -1;
+    if (fgets(line, sizeof(line), in) == NULL)
+    {
+        fclose(in);
+        return -1;
+    }
+    while (count < MAX_RESULTS && fgets(line, sizeof(line), in) != NULL)
+    {
+        p = strchr(line, ',');
+        if (p == NULL || p - line >= (int)sizeof(baseline[count].id))
+            continue;
+        memcpy(baseline[count].id, line, p - line);
+        baseline[count].id[p - line] = '\0';
+        for (m=0; m<2 * METRIC_COUNT && *p == ','; m++)
+        {
+            if (m % 2 == 0)
+                baseline[count].value[m / 2] = strtod(p + 1, &end);
+            else
+                baseline[count].worst[m / 2] = strtod(p + 1, &end);
+            if (end == p + 1)
+                break;
+            p = end;
+        }
+        if (m == 2 * METRIC_WALL)
+            baseline[count].value[METRIC_WALL] =
+                baseline[count].worst[METRIC_WALL] = -1;
+        if (m >= 2 * METRIC_WALL)
+            count++;
+    }
+    fclose(in);
+    return count;
+}
+
+/* write_results() writes the first metrics metrics of the results */
+static void write_results(FILE *out, const result_t *results,
+                          unsigned int count, unsigned int metrics)
+{
+    unsigned int n, m;
+
+    fprintf(out, "config");
+    for (m=0; m<metrics; m++)
+        fprintf(out, ",%s,%s_worst", metric_names[m], metric_names[m]);
+    fprintf(out, "\n");
+    for (n=0; n<count; n++)
+    {
+        fprintf(out, "%s", results[n].id);
+        for (m=0; m<metrics; m++)
+            fprintf(out, m == METRIC_WALL ? ",%.1f,%.1f" : ",%.0f,%.0f",
+                results[n].value[m], results[n].worst[m]);
+        fprintf(out, "\n");
+    }
+}
+
+/*
+ * compare() prints every metric from first up to last of result worse than
+ * in the baseline by more than the tolerance, and returns how many there
+ * are.  Metrics the baseline doesn't have are skipped.
+ */
+static unsigned int compare(const result_t *result, const result_t *baseline,
+                            unsigned int baseline_count,
+                            const double *tolerance, unsigned int first,
+                            unsigned int last)
+{
+    unsigned int n, m, regressions = 0;
+    double base, worst, now;
+
+    for (n=0; n<baseline_count; n++)
+        if (strcmp(baseline[n].id, result->id) == 0)
+            break;
+    if (n == baseline_count)
+    {
+        fprintf(stderr, "%-26s not in the baseline\n", result->id);
+        return 0;
+    }
+
+    for (m = first; m < last; m++)
+    {
+        base = baseline[n].value[m];
+        worst = baseline[n].worst[m];
+        now = result->value[m];
+        if (base < 0)
+            continue;
+        if (now > (2 * worst - base) * (1 + tolerance[m] / 100) &&
+            now - base > metric_floors[m])
+        {
+            fprintf(stderr, "%-26s %s regressed: %.1f -> %.1f (%+.1f%%)\n",
+                result->id, metric_names[m], base, now,
+                base ? 100.0 * (now - base) / base : 100.0);
+            regressions++;
+        }
+    }
+    return regressions;
+}
+
+/*
+ * run_tool() runs the program in argv[0] with its output thrown away, and
+ * returns how long it took in ms, or -1 if it failed.
+ */
+static double run_tool(char *const argv[])
+{
+    struct timespec start, end;
+    int status;
+    pid_t pid;
+
+    fflush(stdout);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0)
+    {
+        freopen("/dev/null", "w", stdout);
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    waitpid(pid, &status, 0);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        return -1;
+    return (end.tv_sec - start.tv_sec) * 1000.0 +
+           (end.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+static double elapsed_ns(const struct timespec *start,
+                         const struct timespec *end)
+{
+    return (end->tv_sec - start->tv_sec) * 1e9 +
+           (end->tv_nsec - start->tv_nsec);
+}
+
+/*
+ * change_state() changes the state of a process the way set_process_state()
+ * does, moving it between the counts atomically.
+ */
+static void change_state(pcb_t *pcb, process_state_t state,
+                         unsigned int *state_count)
+{
+    __atomic_fetch_sub(&state_count[pcb->state], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&state_count[state], 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&pcb->state, state, __ATOMIC_RELAXED);
+}
+
+/*
+ * bench_states() times the per-tick count of the READY, RUNNING and WAITING
+ * processes among count PCBs, both by scanning every PCB, as
+ * print_gantt_line() once did, and by reading the counts set_process_state()
+ * keeps.  Every tick also changes the state of a process, as a handler would,
+ * so that the counts pay for their upkeep.  It returns -1 if the PCBs can't
+ * be allocated.
+ */
+static int bench_states(unsigned int count)
+{
+    unsigned int state_count[PROCESS_TERMINATED + 1] = { 0 };
+    unsigned int n, t, ready, running, waiting;
+    volatile unsigned int sink;
+    struct timespec start, end;
+    double scan, counters;
+    pcb_t *pcbs;
+
+    pcbs = calloc(count, sizeof(pcb_t));
+    if (pcbs == NULL)
+        return -1;
+    for (n=0; n<count; n++)
+    {
+        pcbs[n].state = PROCESS_READY + n % 3;
+        state_count[pcbs[n].state]++;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (t=0; t<SCAN_TICKS; t++)
+    {
+        ready = running = waiting = 0;
+        for (n=0; n<count; n++)
+        {
+            switch (pcbs[n].state)
+            {
+            case PROCESS_READY:
+                ready++;
+                break;
+
+            case PROCESS_RUNNING:
+                running++;
+                break;
+
+            case PROCESS_WAITING:
+                waiting++;
+                break;
+
+            default:
+                break;
+            }
+        }
+        sink = ready + running + waiting;
+        pcbs[t % count].state = PROCESS_READY + (t + 1) % 3;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    scan = elapsed_ns(&start, &end) / SCAN_TICKS;
+
+    /* The scan changed states without counting them */
+    memset(state_count, 0, sizeof(state_count));
+    for (n=0; n<count; n++)
+        state_count[pcbs[n].state]++;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (t=0; t<COUNTER_TICKS; t++)
+    {
+        ready = state_count[PROCESS_READY];
+        running = state_count[PROCESS_RUNNING];
+        waiting = state_count[PROCESS_WAITING];
+        sink = ready + running + waiting;
+        change_state(&pcbs[t % count], PROCESS_READY + (t + 1) % 3,
+                     state_count);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    counters = elapsed_ns(&start, &end) / COUNTER_TICKS;
+    (void)sink;
+    free(pcbs);
+
+    printf("State counts per tick over %u processes: scanning the PCBs "
+        "%.3f ms, keeping counts %.1f ns\n", count, scan / 1e6, counters);
+    return 0;
+}
+
+/*
+ * bench_timeline() records a timeline of ticks ticks in which each column
+ * takes a new random value every fourth tick on average, the seed fixed so
+ * that every run records the same file, and prints its size and how long
+ * ./os-timeline takes over it for the summary, windows of 1000 s and a
+ * process's runs.  It returns -1 if anything failed.
+ */
+static int bench_timeline(unsigned int ticks)
+{
+    static char *views[][5] = {
+        { "./os-timeline", TIMELINE_FILE, NULL },
+        { "./os-timeline", TIMELINE_FILE, "-w", "10000", NULL },
+        { "./os-timeline", TIMELINE_FILE, "-p", "0", NULL }
+    };
+    static const char *view_names[] = { "summary", "-w 10000", "-p 0" };
+    uint32_t values[TIMELINE_CPUS + TIMELINE_COUNTS] = { 0 };
+    unsigned int seed = 1, n, t;
+    struct stat st;
+    double ms;
+
+    if (timeline_open(TIMELINE_FILE, TIMELINE_CPUS) < 0)
+        return -1;
+    for (t=0; t<ticks; t++)
+    {
+        for (n=0; n<TIMELINE_CPUS + TIMELINE_COUNTS; n++)
+        {
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) % 4 == 0)
+                values[n] = (seed >> 20) %
+                    (n < TIMELINE_CPUS ? PROCESS_COUNT + 1 : 16);
+        }
+        timeline_record(t, values);
+    }
+    if (timeline_close() < 0 || stat(TIMELINE_FILE, &st) != 0)
+        return -1;
+
+    printf("%s: %u ticks on %u CPUs, %.0f MB\n", TIMELINE_FILE, ticks,
+        TIMELINE_CPUS, st.st_size / 1e6);
+    for (n=0; n<COUNT(views); n++)
+    {
+        ms = run_tool(views[n]);
+        if (ms < 0)
+            return -1;
+        printf("  %-10s %8.0f ms\n", view_names[n], ms);
+    }
+    return 0;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: ./os-bench [ -o <results> | -B <baseline> ] "
+        "[ -b <baseline> ]\n"
+        "                  [ -l <results> ] [ -n <runs> ] [ -s <percent> ]\n"
+        "                  [ -w <percent> ]\n"
+        "       ./os-bench -c <processes>\n"
+        "       ./os-bench -t <ticks>\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static result_t results[MAX_RESULTS], baseline[MAX_RESULTS];
+    static result_t local[MAX_RESULTS];
+    const char *output = NULL, *baseline_path = NULL, *local_path = NULL;
+    unsigned int metrics = METRIC_COUNT;
+    double tolerance[METRIC_COUNT] = { 10, 10, 10, 50 };
+    unsigned int runs = 5, count = 0, regressions = 0, failures = 0, s, c, w;
+    int baseline_count = 0, local_count = 0, state_processes = 0;
+    int timeline_ticks = 0, n;
+    char args[256];
+    FILE *out = stdout;
+
+    for (n=1; n<argc; n++)
+    {
+        if (n + 1 >= argc)
+        {
+            usage();
+            return -1;
+        }
+        if (strcmp(argv[n], "-o") == 0)
+            output = argv[++n];
+        else if (strcmp(argv[n], "-B") == 0)
+        {
+            output = argv[++n];
+            metrics = METRIC_WALL;
+        }
+        else if (strcmp(argv[n], "-b") == 0)
+            baseline_path = argv[++n];
+        else if (strcmp(argv[n], "-l") == 0)
+            local_path = argv[++n];
+        else if (strcmp(argv[n], "-n") == 0)
+            runs = atoi(argv[++n]);
+        else if (strcmp(argv[n], "-s") == 0)
+            tolerance[METRIC_SWITCHES] = tolerance[METRIC_EXECUTION] =
+                tolerance[METRIC_READY] = atof(argv[++n]);
+        else if (strcmp(argv[n], "-w") == 0)
+            tolerance[METRIC_WALL] = atof(argv[++n]);
+        else if (strcmp(argv[n], "-c") == 0)
+            state_processes = atoi(argv[++n]);
+        else if (strcmp(argv[n], "-t") == 0)
+            timeline_ticks = atoi(argv[++n]);
+        else
+        {
+            usage();
+            return -1;
+        }
+    }
+    if (state_processes < 0 || timeline_ticks < 0)
+    {
+        usage();
+        return -1;
+    }
+    if (state_processes > 0)
+    {
+        if (bench_states(state_processes) < 0)
+        {
+            fprintf(stderr, "Can't allocate %d processes\n", state_processes);
+            return -1;
+        }
+        return 0;
+    }
+    if (timeline_ticks > 0)
+    {
+        if (bench_timeline(timeline_ticks) < 0)
+        {
+            fprintf(stderr, "Timing ./os-timeline failed\n");
+            return -1;
+        }
+        return 0;
+    }
+    if (runs < 1 || runs > MAX_RUNS)
+    {
+        fprintf(stderr, "The runs must be 1 to %d\n", MAX_RUNS);
+        return -1;
+    }
+    if (baseline_path != NULL)
+    {
+        baseline_count = read_baseline(baseline_path, baseline);
+        if (baseline_count < 0)
+        {
+            fprintf(stderr, "%s: can't read the baseline\n", baseline_path);
+            return -1;
+        }
+    }
+    if (local_path != NULL)
+    {
+        local_count = read_baseline(local_path, local);
+        if (local_count < 0)
+        {
+            fprintf(stderr, "%s: can't read the baseline\n", local_path);
+            return -1;
+        }
+    }
+
+    for (s=0; s<COUNT(schedulers); s++)
+        for (c=0; c<COUNT(cpu_counts); c++)
+            for (w=0; w<COUNT(workloads); w++)
+            {
+                if (cpu_counts[c] < schedulers[s].min_cpus)
+                    continue;
+                snprintf(results[count].id, sizeof(results[count].id),
+                    "%s/%u/%s", schedulers[s].name, cpu_counts[c],
+                    workloads[w].name);
+                snprintf(args, sizeof(args), "%u %s %s", cpu_counts[c],
+                    schedulers[s].args, workloads[w].args);
+                timed_out = 0;
+                if (run_config(args, runs, &results[count]) < 0)
+                {
+                    fprintf(stderr, "./os-sim %s %s\n", args,
+                        timed_out ? "timed out" : "failed");
+                    failures++;
+                    continue;
+                }
+                if (baseline_path != NULL)
+                    regressions += compare(&results[count], baseline,
+                                           baseline_count, tolerance, 0,
+                                           METRIC_COUNT);
+                if (local_path != NULL)
+                    regressions += compare(&results[count], local,
+                                           local_count, tolerance,
+                                           METRIC_WALL, METRIC_COUNT);
+                count++;
+            }
+
+    if (output != NULL)
+    {
+        out = fopen(output, "w");
+        if (out == NULL)
+        {
+            fprintf(stderr, "%s: can't create the results\n", output);
+            return -1;
+        }
+    }
+    write_results(out, results, count, metrics);
+    if (out != stdout)
+        fclose(out);
+
+    if (baseline_path != NULL)
+        fprintf(stderr, "%u configurations, %u regressions against %s%s%s\n",
+            count, regressions, baseline_path,
+            local_path != NULL ? " and " : "",
+            local_path != NULL ? local_path : "");
+    else if (local_path != NULL)
+        fprintf(stderr, "%u configurations, %u regressions against %s\n",
+            count, regressions, local_path);
+    if (failures > 0)
+        fprintf(stderr, "%u configurations failed\n", failures);
+    return regressions + failures > 0;
+}
@@ -12,13 +12,27 @@
 
 #include <assert.h>
 #include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#include "arrival.h"
+#include "checkpoint.h"
+#include "disk.h"
+#include "energy.h"
+#include "fiber.h"
+#include "lockstat.h"
+#include "memory.h"
+#include "metrics.h"
 #include "os-sim.h"
+#include "overhead.h"
 #include "process.h"
+#include "program.h"
 #include "student.h"
+#include "sync.h"
+#include "timeline.h"
+#include "timerwheel.h"
 
 
 typedef enum {
@@ -29,31 +43,157 @@ typedef enum {
     CPU_TERMINATE
 } simulator_cpu_state_t;
 
+/*
+ * Rather than counting down every running CPU on every tick, each CPU has a
+ * single timer that expires in the tick in which its next event (end of the
+ * CPU burst or expiry of the time slice, whichever comes first) happens.
+ *
+ *   state           : the CPU's mailbox: the event handed to its thread,
+ *                     or what the thread is doing
+ *   posted          : the number of events handed to the thread
+ *   wakeup          : signalled when an event is handed to the thread
+ *   switched        : broadcast when the thread calls context_switch(),
+ *                     which completes the event
+ *   preemption_time : the time slice given to context_switch()
+ *   dispatched_at   : the first tick simulated for the current process
+ *   burst_left      : the length of the CPU burst left at dispatch
+ *   switches        : the number of context_switch() calls on this CPU,
+ *                     the token a handoff waits on
+ *   freq_level      : the frequency level set with set_cpu_frequency()
+ *   run_level       : the frequency level of the current process's dispatch
+ *   capacity        : the CPU's capacity (see set_cpu_capacities())
+ *   speed           : the speed the current process runs at, which changes
+ *                     as the CPU's SMT sibling becomes busy or idle
+ *   work_carry      : the work done towards the next whole tick of work,
+ *                     in 1/1000 ticks, at dispatch or when the speed last
+ *                     changed
+ *   busy_since      : the tick the CPU last became busy
+ *   idle_since      : the tick the CPU last became idle
+ *   cstate          : the idle state set with set_idle_state()
+ *   idle_cstate     : the idle state of the current idle interval
+ *   wake_latency    : the exit latency of the idle state the CPU woke from
+ *   page_faults     : the pages missing when the current process was
+ *                     dispatched; the CPU takes the fault instead of running
+ *   last_process    : the process the CPU ran last
+ *   overhead        : the ticks the current dispatch costs (see overhead.h)
+ *   overhead_carry  : the part of a tick of overhead owed to the next
+ *                     dispatch
+ */
 typedef struct {
     pcb_t *current;
     simulator_cpu_state_t state;
-    pthread_cond_t wakeup;
-    int preemption_timer;
+    unsigned int posted;
+    fiber_cond_t wakeup;
+    fiber_cond_t switched;
+    int preemption_time;
+    unsigned int dispatched_at;
+    unsigned int burst_left;
+    sim_timer timer;
+    unsigned int switches;
+    unsigned int freq_level;
+    unsigned int run_level;
+    unsigned int capacity;
+    unsigned int speed;
+    unsigned int work_carry;
+    unsigned int busy_since;
+    unsigned int idle_since;
+    unsigned int cstate;
+    unsigned int idle_cstate;
+    unsigned int wake_latency;
+    unsigned int page_faults;
+    pcb_t *last_process;
+    unsigned int overhead;
+    unsigned int overhead_carry;
 } simulator_cpu_data_t;
 
-/* The I/O queue is a simple, FIFO queue using a linked list */
+/*
+ * Each device has an I/O queue, a simple FIFO queue using a linked list.
+ * The request at the head of the queue has its timer armed for its
+ * completion.  The disk serves OP_IO operations; the paging device serves
+ * page faults, loading pages rather than moving the process's "PC".  With
+ * the disk model, the device's I/O scheduler picks the request it serves
+ * next and moves it to the head (see disk.h).
+ */
 typedef struct _io_request {
     pcb_t *pcb;
     unsigned int execution_time;
+    disk_request_t io;
+    sim_timer timer;
     struct _io_request *next;
 } io_request;
 
+typedef struct {
+    io_request *head, *tail;
+    unsigned int timer_key;
+    unsigned int length;
+    disk_t model;
+} io_device;
 
-static io_request *io_queue_head = NULL, *io_queue_tail = NULL;
+/*
+ * Timers expiring in the same tick fire in key order: the CPUs in order of
+ * their id, then the disk and the paging device.  Beyond MAX_CPU_THREADS
+ * CPUs, the CPUs must be fibers (see set_fiber_workers()).
+ */
+#define MAX_CPU_COUNT 16384
+#define MAX_CPU_THREADS 64
+#define TIMER_KEY_IO MAX_CPU_COUNT
+#define TIMER_KEY_PAGING (TIMER_KEY_IO + 1)
+#define TIMER_KEY_POLICY (TIMER_KEY_PAGING + 1)
+
+
+static io_device disk = { NULL, NULL, TIMER_KEY_IO, 0 };
+static io_device paging_device = { NULL, NULL, TIMER_KEY_PAGING, 0 };
 static simulator_cpu_data_t *simulator_cpu_data;
 static pthread_t *cpu_thread;
-static pthread_mutex_t simulator_mutex;
-static pthread_cond_t thread_yielded;
+static lockstat_mutex_t simulator_mutex;
+#ifdef LOCKSTAT
+/*
+ * Every event handed to a CPU thread is recorded as an acquisition, waiting
+ * until the thread switched, and as contended if the waiter was woken up
+ * before that.
+ */
+static lockstat_t handoff_stat;
+#endif
 static unsigned int simulator_time = 0;
 static unsigned int processes_terminated = 0;
 static unsigned int cpu_count;
 static unsigned int ready_counter = 0, running_counter = 0, waiting_counter = 0;
+static unsigned int state_count[PROCESS_TERMINATED + 1];
 static unsigned int context_switches = 0;
+static unsigned int idle_ready_counter = 0;
+static double energy_used = 0.0;
+static timer_wheel sim_timers;
+static sim_timer policy_timer_event;
+static unsigned int next_cpu_tick = 0;
+static unsigned int memory_frames = 0;
+static int lock_workload = 0;
+static int arrivals_set = 0;
+static metrics_t live_metrics;
+static pcb_t *lock_wakeups[PROCESS_COUNT];
+static unsigned int lock_wakeup_count = 0;
+static pcb_t *tick_wakeups[PROCESS_COUNT];
+static unsigned int tick_wakeup_count = 0;
+static unsigned int paging_wait_counter = 0;
+static unsigned int processes_created = 0;
+static unsigned int ready_order[PROCESS_COUNT];
+static unsigned int ready_sequence = 0;
+static const char *checkpoint_path = NULL;
+static unsigned int checkpoint_tick = 0;
+static volatile sig_atomic_t checkpoint_requested = 0;
+static const char *restore_path = NULL;
+static pcb_t *resumed[PROCESS_COUNT];
+static unsigned int resumed_count = 0;
+static const char *timeline_path = NULL;
+static uint32_t *timeline_row;
+static int last_cpu[PROCESS_COUNT];
+static unsigned int carried_work[PROCESS_COUNT]; /* work_carry of a process
+                                                    taken off its CPU */
+static unsigned int cpu_capacity[MAX_CPU_COUNT];
+static int capacities_set = 0;
+static unsigned int smt_throughput = 0;
+static unsigned int smt_shared_since[MAX_CPU_COUNT / 2];
+static unsigned int smt_shared_ticks = 0;
+static unsigned int fiber_workers = 0;
 
 static void simulator_supervisor_thread(void);
 static void simulator_cpu_thread(unsigned int cpu_id);
@@ -62,12 +202,41 @@ int nanosleep(const struct timespec *rqtp, struct timespec *rmtp);
 
 static void print_gantt_header(void);
 static void print_gantt_line(void);static void print_final_stats(void);
+static void publish_metrics(void);
+static void record_timeline(unsigned int running, unsigned int ready,
+                            unsigned int waiting);
 
 static void simulate_cpus(void);
 static void simulate_process(unsigned int cpu_id, pcb_t *pcb);
-static void submit_io_request(pcb_t *pcb, unsigned int execution_time);
-static void simulate_io(void);
+static unsigned int cpu_speed(unsigned int cpu_id);
+static void arm_cpu_timer(unsigned int cpu_id);
+static void set_cpu_timer(unsigned int cpu_id);
+static void sibling_changed(unsigned int cpu_id, int busy);
+static unsigned int smt_shared_open(unsigned int now);
+static void save_progress(unsigned int cpu_id, unsigned int elapsed);
+static void stop_cpu_timer(unsigned int cpu_id);
+static void account_energy(unsigned int cpu_id, pcb_t *next);
+static void charge_overhead(unsigned int cpu_id, pcb_t *next);
+static void signal_cpu(unsigned int cpu_id, simulator_cpu_state_t event);
+static int run_instant_ops(pcb_t *pcb);
+static void submit_io_request(io_device *device, pcb_t *pcb,
+                              unsigned int execution_time);
+static io_request *queue_io_request(io_device *device, pcb_t *pcb,
+                                    unsigned int execution_time);
+static void start_io_request(io_device *device, unsigned int start);
+static void simulate_io(io_device *device);
+static void simulate_locks(void);
+static void simulate_policy_timer(void);
 static void simulate_creat(void);
+static void queue_wakeup(pcb_t *pcb);
+static void deliver_wakeups(void);
+
+static void request_checkpoint(int signal);
+static void save_checkpoint(void);
+static void save_device(io_device *device);
+static void restore_checkpoint(void);
+static void restore_device(io_device *device);
+static void resume_processes(void);
 
 static void* simulator_cpu_thread_func(void *data);
 
@@ -93,8 +262,14 @@ typedef struct {
     pthread_mutex_t mutex;
     pthread_cond_t no_writers;
     int writers;
+#ifdef LOCKSTAT
+    lockstat_t read_stat, write_stat;
+    unsigned long long read_start;
+#endif
 } irwl;
 
+#ifndef LOCKSTAT
+
 #define IRWL_INIT(i) \
     pthread_mutex_init(&(i).mutex, NULL); \
     pthread_cond_init(&(i).no_writers, NULL); \
@@ -120,6 +295,71 @@ typedef struct {
     { pthread_cond_signal(&(i).no_writers); } \
     pthread_mutex_unlock(&(i).mutex);
 
+#else /* LOCKSTAT */
+
+/*
+ * The instrumented IRWL accounts the single reader as an exclusive lock:
+ * its wait covers both the internal mutex and any writers still running.
+ * Writers share the lock, so each one's hold starts when it took the lock
+ * on its own thread.  A writer never waits for an event while it holds the
+ * lock, so a fiber holding it keeps its worker thread throughout.  A CPU
+ * dispatching from idle() releases the lock without having taken it, which
+ * records no hold.
+ */
+static __thread unsigned long long irwl_write_start;
+
+#define IRWL_INIT(i) \
+    pthread_mutex_init(&(i).mutex, NULL); \
+    pthread_cond_init(&(i).no_writers, NULL); \
+    (i).writers = 0; \
+    lockstat_register(&(i).read_stat, #i " (read)"); \
+    lockstat_register(&(i).write_stat, #i " (write)");
+
+#define IRWL_READER_LOCK(i) \
+    { \
+        unsigned long long irwl_start = lockstat_now(); \
+        int irwl_contended = 0; \
+        if (pthread_mutex_trylock(&(i).mutex) != 0) \
+        { irwl_contended = 1; pthread_mutex_lock(&(i).mutex); } \
+        while ((i).writers > 0) \
+        { \
+            irwl_contended = 1; \
+            pthread_cond_wait(&(i).no_writers, &(i).mutex); \
+        } \
+        lockstat_acquired(&(i).read_stat, irwl_start, irwl_contended); \
+        (i).read_start = lockstat_now(); \
+    }
+
+#define IRWL_READER_UNLOCK(i) \
+    lockstat_held(&(i).read_stat, (i).read_start); \
+    pthread_mutex_unlock(&(i).mutex);
+
+#define IRWL_WRITER_LOCK(i) \
+    { \
+        unsigned long long irwl_start = lockstat_now(); \
+        int irwl_contended = 0; \
+        if (pthread_mutex_trylock(&(i).mutex) != 0) \
+        { irwl_contended = 1; pthread_mutex_lock(&(i).mutex); } \
+        lockstat_acquired(&(i).write_stat, irwl_start, irwl_contended); \
+        (i).writers++; \
+        pthread_mutex_unlock(&(i).mutex); \
+        irwl_write_start = lockstat_now(); \
+    }
+
+#define IRWL_WRITER_UNLOCK(i) \
+    pthread_mutex_lock(&(i).mutex); \
+    if (irwl_write_start != 0) \
+    { \
+        lockstat_held(&(i).write_stat, irwl_write_start); \
+        irwl_write_start = 0; \
+    } \
+    (i).writers--; \
+    if ((i).writers == 0) \
+    { pthread_cond_signal(&(i).no_writers); } \
+    pthread_mutex_unlock(&(i).mutex);
+
+#endif /* LOCKSTAT */
+
 static irwl student_lock;
 
 
@@ -130,37 +370,95 @@ extern void start_simulator(unsigned int new_cpu_count)
 
     /* Make sure the # of CPUs is reasonable */
     cpu_count = new_cpu_count;
-    if (cpu_count < 1 || cpu_count > 16)
+    if (cpu_count < 1 ||
+        cpu_count > (fiber_workers > 0 ? MAX_CPU_COUNT : MAX_CPU_THREADS))
     {
-        fprintf(stderr, "CPU Count must be an integer from 1 to 16!\n\n");
+        fprintf(stderr, "CPU Count must be an integer from 1 to %d, or to %d "
+            "with fibers!\n\n", MAX_CPU_THREADS, MAX_CPU_COUNT);
         exit(-1);
     }
 
 
     /* Allocate arrays */
-    cpu_thread = malloc(sizeof(pthread_t) * cpu_count);
-    assert(cpu_thread != NULL);
     simulator_cpu_data = malloc(sizeof(simulator_cpu_data_t) * cpu_count);
     assert(simulator_cpu_data != NULL);
 
     /* Initialize mutexes and condition variables */
-    pthread_mutex_init(&simulator_mutex, NULL);
-	pthread_cond_init(&thread_yielded, NULL);
+    LOCKSTAT_MUTEX_INIT(&simulator_mutex, "simulator_mutex");
+#ifdef LOCKSTAT
+    lockstat_register(&handoff_stat, "cpu handoff");
+#endif
     simulator_time = 0;
+    timer_wheel_init(&sim_timers, simulator_time);
+    memory_init(memory_frames);
+    sync_init(lock_workload);
+    state_count[PROCESS_NEW] = PROCESS_COUNT;
+    if (!arrivals_set)
+        arrival_init(NULL, 0);
+    policy_timer_event.next = NULL;
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        program_reset(&processes[n]);
+        last_cpu[n] = -1;
+    }
     for (n=0; n<cpu_count; n++)
     {
         simulator_cpu_data[n].current = NULL;
         simulator_cpu_data[n].state = CPU_IDLE;
-        simulator_cpu_data[n].preemption_timer = -1;
-        pthread_cond_init(&simulator_cpu_data[n].wakeup, NULL);
+        simulator_cpu_data[n].posted = 0;
+        simulator_cpu_data[n].preemption_time = -1;
+        simulator_cpu_data[n].timer.next = NULL;
+        simulator_cpu_data[n].switches = 0;
+        simulator_cpu_data[n].freq_level = 0;
+        simulator_cpu_data[n].run_level = 0;
+        simulator_cpu_data[n].capacity = get_cpu_capacity(n);
+        simulator_cpu_data[n].busy_since = 0;
+        simulator_cpu_data[n].idle_since = 0;
+        simulator_cpu_data[n].cstate = 0;
+        simulator_cpu_data[n].idle_cstate = 0;
+        simulator_cpu_data[n].wake_latency = 0;
+        simulator_cpu_data[n].page_faults = 0;
+        simulator_cpu_data[n].last_process = NULL;
+        simulator_cpu_data[n].overhead = 0;
+        simulator_cpu_data[n].overhead_carry = 0;
+        fiber_cond_init(&simulator_cpu_data[n].wakeup);
+        fiber_cond_init(&simulator_cpu_data[n].switched);
+    }
+    if (restore_path != NULL)
+        restore_checkpoint();
+    if (timeline_path != NULL)
+    {
+        if (timeline_open(timeline_path, cpu_count) < 0)
+            exit(-1);
+        timeline_row = malloc(sizeof(uint32_t) * (cpu_count + TIMELINE_COUNTS));
+        assert(timeline_row != NULL);
+    }
+    if (checkpoint_path != NULL)
+    {
+        struct sigaction action;
+
+        action.sa_handler = request_checkpoint;
+        sigemptyset(&action.sa_mask);
+        action.sa_flags = SA_RESTART;
+        sigaction(SIGUSR1, &action, NULL);
     }
 
     IRWL_INIT(student_lock)
 
-    /* Start CPU threads */
-    for (n=0; n<cpu_count; n++)
-        pthread_create(&cpu_thread[n], NULL, simulator_cpu_thread_func,
-                       (void*)(long)n);
+    /* Start CPU threads, or CPU fibers on the worker threads */
+    if (fiber_workers > 0)
+    {
+        fiber_start(fiber_workers < cpu_count ? fiber_workers : cpu_count,
+                    cpu_count, simulator_cpu_thread);
+    }
+    else
+    {
+        cpu_thread = malloc(sizeof(pthread_t) * cpu_count);
+        assert(cpu_thread != NULL);
+        for (n=0; n<cpu_count; n++)
+            pthread_create(&cpu_thread[n], NULL, simulator_cpu_thread_func,
+                           (void*)(long)n);
+    }
 
     /* Start supervisor thread */
     simulator_supervisor_thread();
@@ -175,26 +473,45 @@ extern void start_simulator(unsigned int new_cpu_count)
 static void simulator_supervisor_thread(void)
 {
     print_gantt_header();
+    resume_processes();
 
     /* Loop, performing execution every 100ms.  At each execution, we will
        display a line in the Gantt chart and check for pending I/O requests */
     while (1)
     {
-        pthread_mutex_lock(&simulator_mutex);
+        LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
 
         /* Exit when all processes terminate */
         if (processes_terminated >= PROCESS_COUNT)
         {
             print_final_stats();
+            if (timeline_close() < 0)
+                fprintf(stderr, "%s: the timeline is incomplete\n",
+                    timeline_path);
+            live_metrics.finished = 1;
+            publish_metrics();
+            metrics_close();
             exit(0);
         }
 
+        if (checkpoint_requested ||
+            (checkpoint_tick != 0 && simulator_time == checkpoint_tick))
+        {
+            checkpoint_requested = 0;
+            save_checkpoint();
+        }
+
         print_gantt_line();
+        publish_metrics();
         simulate_cpus();
-        simulate_io();
+        simulate_io(&disk);
+        simulate_io(&paging_device);
+        simulate_locks();
+        simulate_policy_timer();
         simulate_creat();
+        deliver_wakeups();
         simulator_time++;
-        pthread_mutex_unlock(&simulator_mutex);
+        LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
 
         mt_safe_usleep(1);
     }
@@ -224,14 +541,19 @@ static void simulator_supervisor_thread(void)
  * There is one special case: idle.  Idle is simulated by the student's code,
  * not the library's.  So we simply set the state variable to CPU_IDLE, and
  * call the student's code.
+ *
+ * With set_fiber_workers(), this loop runs on a fiber rather than a thread
+ * of its own, and blocking on the condition variable switches the fiber out
+ * (see fiber.h).
  */
 static void simulator_cpu_thread(unsigned int cpu_id)
 {
     simulator_cpu_state_t state;
+    unsigned int handled = 0;
 
     while (1)
     {
-        pthread_mutex_lock(&simulator_mutex);
+        LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
         if (simulator_cpu_data[cpu_id].current == NULL)
         {
             /* the idle process was selected */
@@ -239,15 +561,21 @@ static void simulator_cpu_thread(unsigned int cpu_id)
         }
         else
         {
-            /* a process was scheduled */
-            simulator_cpu_data[cpu_id].state = CPU_RUNNING;
+            /*
+             * a process was scheduled.  Its timer may have expired since
+             * context_switch(), and an event been posted for it already,
+             * which must not be overwritten.
+             */
+            if (simulator_cpu_data[cpu_id].posted == handled)
+                simulator_cpu_data[cpu_id].state = CPU_RUNNING;
 
             while (simulator_cpu_data[cpu_id].state == CPU_RUNNING)
-                pthread_cond_wait(&simulator_cpu_data[cpu_id].wakeup,
+                LOCKSTAT_COND_WAIT(&simulator_cpu_data[cpu_id].wakeup,
                     &simulator_mutex);
+            handled = simulator_cpu_data[cpu_id].posted;
         }
         state = simulator_cpu_data[cpu_id].state;
-        pthread_mutex_unlock(&simulator_mutex);
+        LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
 
         /* Call student's code */
         switch (state)
@@ -299,11 +627,16 @@ static void print_gantt_header(void)
     printf("Time  Ru Re Wa     ");
     for (n=0; n<cpu_count; n++)
         printf(" CPU %d   ", n);
-    printf("     < I/O Queue <\n"
-           "===== == == ==     ");
+    printf("     < I/O Queue <");
+    if (memory_enabled())
+        printf("     < Paging <");
+    printf("\n===== == == ==     ");
     for (n=0; n<cpu_count; n++)
         printf(" ========");
-    printf("     =============\n");
+    printf("     =============");
+    if (memory_enabled())
+        printf("     ==========");
+    printf("\n");
 }
 
 static void print_gantt_line(void)
@@ -314,65 +647,177 @@ static void print_gantt_line(void)
 
 
     /*
-     * Update number of processes in each state.
+     * Update number of processes in each state.  set_process_state() keeps
+     * the counts, so this costs the same however many processes there are.
+     * Holding the reader lock means no handler is halfway through a change.
      */
     IRWL_READER_LOCK(student_lock)
-    for (n=0; n<PROCESS_COUNT; n++)
-    {
-        switch(processes[n].state)
-        {
-        case PROCESS_READY:
-            current_ready++;
-            ready_counter++;
-            break;
-
-        case PROCESS_RUNNING:
-            current_running++;
-            running_counter++;
-            break;
-
-        case PROCESS_WAITING:
-            current_waiting++;
-            waiting_counter++;
-            break;
-
-        default:
-            break;
-        }
-    }
+    current_ready = state_count[PROCESS_READY];
+    current_running = state_count[PROCESS_RUNNING];
+    current_waiting = state_count[PROCESS_WAITING];
     IRWL_READER_UNLOCK(student_lock)
+    ready_counter += current_ready;
+    running_counter += current_running;
+    waiting_counter += current_waiting;
 
 
     /* Print time */
     printf("%-5.1f %-2d %-2d %-2d     ", (float)simulator_time / 10.0,
         current_running, current_ready, current_waiting);
 
-    /* Print running processes */
+    /*
+     * Print running processes.  A CPU that is idle while processes are
+     * READY is lost to fragmentation (e.g. a gang that does not fit).
+     */
     for (n=0; n<cpu_count; n++)
     {
         if (simulator_cpu_data[n].current != NULL)
+        {
             printf(" %-8s", simulator_cpu_data[n].current->name);
+            if (n < METRICS_MAX_CPUS)
+                live_metrics.cpu_busy[n]++;
+        }
         else
+        {
             printf(" (IDLE)  ");
+            if (current_ready > 0)
+                idle_ready_counter++;
+        }
     }
 
     /* Print I/O requests */
     printf("     <");
-    r = io_queue_head;
-    while (r != NULL)
-    {
+    for (r = disk.head; r != NULL; r = r->next)
         printf(" %s", r->pcb->name);
-        r = r->next;
+    printf(" <");
+    if (memory_enabled())
+    {
+        printf("     <");
+        for (r = paging_device.head; r != NULL; r = r->next)
+            printf(" %s", r->pcb->name);
+        printf(" <");
     }
-    printf(" <\n");
+    printf("\n");
+
+    if (timeline_path != NULL)
+        record_timeline(current_running, current_ready, current_waiting);
+}
+
+/*
+ * record_timeline() adds this tick's line of the Gantt chart to the
+ * timeline: the CPUs' processes, as 1 + their pid, then the state counts and
+ * the I/O queue lengths.
+ */
+static void record_timeline(unsigned int running, unsigned int ready,
+                            unsigned int waiting)
+{
+    int n;
+
+    for (n=0; n<cpu_count; n++)
+        timeline_row[n] = simulator_cpu_data[n].current != NULL ?
+            simulator_cpu_data[n].current->pid + 1 : 0;
+    timeline_row[cpu_count + TIMELINE_RUNNING] = running;
+    timeline_row[cpu_count + TIMELINE_READY] = ready;
+    timeline_row[cpu_count + TIMELINE_WAITING] = waiting;
+    timeline_row[cpu_count + TIMELINE_IO_QUEUE] = disk.length;
+    timeline_row[cpu_count + TIMELINE_PAGING_QUEUE] = paging_device.length;
+    timeline_record(simulator_time, timeline_row);
+}
+
+/*
+ * publish_metrics() publishes the counters as of the start of this tick to
+ * the live metrics segment, if any.  Ticks per second are measured over
+ * whole seconds of wall-clock time.  The state counts are read without the
+ * student_lock, as the supervisor must not wait for handlers here; a count
+ * may be off by a transition in progress.
+ */
+static void publish_metrics(void)
+{
+    static uint64_t second_start_ns = 0, second_start_tick = 0;
+    struct timespec ts;
+    uint64_t now_ns;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now_ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    if (now_ns - second_start_ns >= 1000000000ULL)
+    {
+        if (second_start_ns != 0)
+            live_metrics.ticks_per_second =
+                (simulator_time - second_start_tick) * 1000000000ULL /
+                (now_ns - second_start_ns);
+        second_start_ns = now_ns;
+        second_start_tick = simulator_time;
+    }
+
+    live_metrics.simulator_time = simulator_time;
+    live_metrics.wall_ns = now_ns;
+    live_metrics.context_switches = context_switches;
+    live_metrics.new =
+        __atomic_load_n(&state_count[PROCESS_NEW], __ATOMIC_RELAXED);
+    live_metrics.ready =
+        __atomic_load_n(&state_count[PROCESS_READY], __ATOMIC_RELAXED);
+    live_metrics.running =
+        __atomic_load_n(&state_count[PROCESS_RUNNING], __ATOMIC_RELAXED);
+    live_metrics.waiting =
+        __atomic_load_n(&state_count[PROCESS_WAITING], __ATOMIC_RELAXED);
+    live_metrics.terminated =
+        __atomic_load_n(&state_count[PROCESS_TERMINATED], __ATOMIC_RELAXED);
+    live_metrics.io_queue = disk.length;
+    live_metrics.paging_queue = paging_device.length;
+    live_metrics.cpu_count = cpu_count;
+    metrics_publish(&live_metrics);
 }
 
 static void print_final_stats(void)
 {
+    unsigned int exit_latency, n, cstate_total = 0;
+
+    /* Close the busy or idle interval every CPU is in */
+    for (n=0; n<cpu_count; n++)
+    {
+        if (simulator_cpu_data[n].current != NULL)
+            energy_used += energy_busy(simulator_cpu_data[n].run_level,
+                simulator_cpu_data[n].capacity,
+                simulator_time - simulator_cpu_data[n].busy_since);
+        else
+            energy_used += energy_idle(
+                simulator_time - simulator_cpu_data[n].idle_since,
+                simulator_cpu_data[n].idle_cstate, &exit_latency);
+    }
+    for (n=0; n<CSTATE_COUNT; n++)
+        cstate_total += cstate_ticks[n];
+    smt_shared_ticks += smt_shared_open(simulator_time);
+
     printf("\n\n");
     printf("# of Context Switches: %u\n", context_switches);
     printf("Total execution time: %.1f s\n", (float)simulator_time / 10.0);
     printf("Total time spent in READY state: %.1f s\n", (float)ready_counter / 10.0);
+    printf("Idle CPU time while processes were READY: %.1f s\n",
+        (float)idle_ready_counter / 10.0);
+    overhead_print_stats(running_counter, simulator_time * cpu_count);
+    disk_print_stats(&disk.model, "Disk", simulator_time);
+    if (memory_enabled())
+        disk_print_stats(&paging_device.model, "Paging device", simulator_time);
+    if (smt_throughput != 0)
+        printf("SMT siblings both busy: %.1f s over all cores, %.1f%% of busy "
+            "CPU time ran at %.0f%% throughput\n", (float)smt_shared_ticks / 10.0,
+            running_counter ? 200.0 * smt_shared_ticks / running_counter : 0.0,
+            smt_throughput / 10.0);
+    arrival_print_stats();
+    printf("Total energy: %.1f J (average power %.2f W)\n", energy_used,
+        simulator_time ? energy_used / (simulator_time * TICK_SECONDS) : 0.0);
+    printf("Idle time by C-state:");
+    for (n=0; n<CSTATE_COUNT; n++)
+        printf(" %s %.1f%%", cstates[n].name,
+            cstate_total ? 100.0 * cstate_ticks[n] / cstate_total : 0.0);
+    printf("\n");
+    if (memory_enabled())
+        printf("Total time spent waiting for the paging device: %.1f s\n",
+            (float)paging_wait_counter / 10.0);
+    memory_print_stats(simulator_time);
+    sync_print_stats();
+    print_scheduler_stats(simulator_time);
+    lockstat_dump();
 }
 
 
@@ -384,6 +829,8 @@ static void print_final_stats(void)
 extern void context_switch(unsigned int cpu_id, pcb_t *pcb,
                            int preemption_time)
 {
+    int was_busy;
+
     assert(cpu_id < cpu_count);
     assert(pcb == NULL || (pcb >= processes && pcb <= processes +
         PROCESS_COUNT - 1));
@@ -391,11 +838,21 @@ extern void context_switch(unsigned int cpu_id, pcb_t *pcb,
     context_switches++;
 
     IRWL_WRITER_UNLOCK(student_lock);
-    pthread_mutex_lock(&simulator_mutex);
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
+    stop_cpu_timer(cpu_id);
+    account_energy(cpu_id, pcb);
+    if (pcb != NULL)
+        charge_overhead(cpu_id, pcb);
+    was_busy = simulator_cpu_data[cpu_id].current != NULL;
     simulator_cpu_data[cpu_id].current = pcb;
-    simulator_cpu_data[cpu_id].preemption_timer = preemption_time;
-	pthread_cond_signal(&thread_yielded);
-    pthread_mutex_unlock(&simulator_mutex);
+    simulator_cpu_data[cpu_id].preemption_time = preemption_time;
+    if (pcb != NULL)
+        arm_cpu_timer(cpu_id);
+    if (was_busy != (pcb != NULL))
+        sibling_changed(cpu_id, pcb != NULL);
+    simulator_cpu_data[cpu_id].switches++;
+    fiber_cond_broadcast(&simulator_cpu_data[cpu_id].switched);
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
     IRWL_WRITER_LOCK(student_lock);
 }
 
@@ -404,7 +861,7 @@ extern void force_preempt(unsigned int cpu_id)
     assert(cpu_id < cpu_count);
 
     IRWL_WRITER_UNLOCK(student_lock);
-    pthread_mutex_lock(&simulator_mutex);
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
 
     /*
      * It is possible that the student's code calls force_preempt() at the
@@ -413,102 +870,564 @@ extern void force_preempt(unsigned int cpu_id)
      */
     if (simulator_cpu_data[cpu_id].state == CPU_RUNNING)
     {
-        simulator_cpu_data[cpu_id].state = CPU_PREEMPT;
-        pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-		// wait to make sure thread finishes preempt and context switch
-		pthread_cond_wait(&thread_yielded, &simulator_mutex);
+        stop_cpu_timer(cpu_id);
+        signal_cpu(cpu_id, CPU_PREEMPT);
     }
 
-    pthread_mutex_unlock(&simulator_mutex);
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
     IRWL_WRITER_LOCK(student_lock);
 }
 
 
 
+/*
+ * Handlers run concurrently under the writer side of the student_lock, so
+ * the counts are updated atomically.  The order in which processes became
+ * READY is kept for checkpoints.
+ */
+extern void set_process_state(pcb_t *pcb, process_state_t state)
+{
+    __atomic_fetch_sub(&state_count[pcb->state], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&state_count[state], 1, __ATOMIC_RELAXED);
+    if (state == PROCESS_READY)
+        ready_order[pcb->pid] =
+            __atomic_fetch_add(&ready_sequence, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&pcb->state, state, __ATOMIC_RELAXED);
+}
+
+extern int set_metrics_name(const char *name)
+{
+    return metrics_open(name);
+}
+
+extern void set_checkpoint(const char *path, unsigned int tick)
+{
+    checkpoint_path = path;
+    checkpoint_tick = tick;
+}
+
+extern void set_restore(const char *path)
+{
+    restore_path = path;
+}
+
+extern int set_overhead_model(const char *spec)
+{
+    return overhead_init(spec);
+}
+
+extern int set_disk_model(const char *spec)
+{
+    return disk_init(spec);
+}
+
+extern int set_fiber_workers(unsigned int workers)
+{
+    if (workers < 1)
+        return -1;
+    fiber_workers = workers;
+    return 0;
+}
+
+extern void set_timeline(const char *path)
+{
+    timeline_path = path;
+}
+
+extern void set_memory_frames(unsigned int frames)
+{
+    memory_frames = frames;
+}
+
+extern void set_lock_workload(void)
+{
+    lock_workload = 1;
+}
+
+extern int set_arrival_model(const char *spec, unsigned int seed)
+{
+    arrivals_set = 1;
+    return arrival_init(spec, seed);
+}
+
+extern int set_cpu_capacities(const char *spec)
+{
+    const char *p = spec;
+    char *end;
+    unsigned long value = 0;
+    unsigned int n;
+
+    if (*p == '\0')
+        return -1;
+    for (n=0; n<MAX_CPU_COUNT; n++)
+    {
+        if (*p != '\0')
+        {
+            value = strtoul(p, &end, 10);
+            if (end == p || value < CPU_CAPACITY_MIN || value > 1000)
+                return -1;
+            p = end;
+            if (*p == ',' && *++p == '\0')
+                return -1;
+        }
+        cpu_capacity[n] = (unsigned int)value;
+    }
+    if (*p != '\0')
+        return -1;
+    capacities_set = 1;
+    return 0;
+}
+
+extern unsigned int get_cpu_capacity(unsigned int cpu_id)
+{
+    return capacities_set && cpu_id < MAX_CPU_COUNT ?
+           cpu_capacity[cpu_id] : 1000;
+}
+
+extern int set_smt_throughput(unsigned int throughput)
+{
+    if (throughput < SMT_THROUGHPUT_MIN || throughput > 1000)
+        return -1;
+    smt_throughput = throughput;
+    return 0;
+}
+
+extern int get_cpu_sibling(unsigned int cpu_id)
+{
+    return smt_throughput != 0 ? (int)(cpu_id ^ 1) : -1;
+}
+
+extern void set_cpu_frequency(unsigned int cpu_id, unsigned int level)
+{
+    assert(cpu_id < cpu_count);
+    assert(level < CPU_FREQ_LEVELS);
+
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
+    simulator_cpu_data[cpu_id].freq_level = level;
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
+}
+
+extern void set_idle_state(unsigned int cpu_id, unsigned int cstate)
+{
+    assert(cpu_id < cpu_count);
+    assert(cstate < CSTATE_COUNT);
+
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
+    simulator_cpu_data[cpu_id].cstate = cstate;
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
+}
+
+extern void set_policy_timer(unsigned int tick)
+{
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
+    if (!timer_pending(&policy_timer_event) ||
+        (int)(tick - policy_timer_event.expires) < 0)
+    {
+        timer_wheel_add(&sim_timers, &policy_timer_event, tick,
+                        TIMER_KEY_POLICY);
+    }
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
+}
+
+extern unsigned int get_simulator_time(void)
+{
+    unsigned int now;
+
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
+    now = next_cpu_tick;
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
+
+    return now;
+}
+
+
+
 /*
  * The functions below are used by the supervisor thread to simulate the OS.
  *
- * simulate_cpus() / simulate_process() simulate the processes on each CPU
- *   and signal the appropriate CPU thread if an event occurs.
+ * simulate_cpus() / simulate_process() expire the CPU timers due in the
+ *   current tick and signal the appropriate CPU thread for each event.
+ *
+ * run_instant_ops() runs the operations that take no time at a process's
+ *   "PC", and returns 0 if the process blocked on a lock.
+ *
+ * submit_io_request() inserts a PCB into tail of a device's I/O queue,
+ *   starting it if the device is free.
+ *
+ * queue_io_request() builds a request and appends it to a device's queue.
+ *
+ * start_io_request() moves the request a free device serves next to the
+ *   head of its queue and arms its timer, counting from tick start.
+ *
+ * simulate_io() completes the I/O request at the head of a device's I/O
+ *   queue when its timer expires and queues its process to be woken up.
  *
- * submit_io_request() inserts a PCB into tail of the I/O queue.
+ * simulate_locks() queues the processes handed a lock to be woken up.
  *
- * simulate_io() simulates the I/O request at the head of the I/O queue and
- *   calls wake_up() upon completion.
+ * simulate_policy_timer() calls the student's policy_timer() when the timer
+ *   set with set_policy_timer() expires.
  *
- * simulate_creat() simulates initial process creation by calling the
- *   student's wake_up().
+ * simulate_creat() simulates process creation by queueing every process
+ *   whose arrival is due to be woken up.
+ *
+ * queue_wakeup() adds a process that became READY to the ones woken up at
+ *   the end of the tick.
+ *
+ * deliver_wakeups() sets the priorities inherited through the locks that
+ *   changed in the tick, and calls the student's priority_changed() for each
+ *   process.  It then hands the processes woken up in the tick to the
+ *   student's wake_up(), or to wake_up_batch() in one call if there are
+ *   several, in the order they were queued: I/O completions, page-ins, lock
+ *   handoffs, then arrivals.  The locks are dropped and taken again once per
+ *   tick, however many there are.
+ *
+ * wake_up_batch() is the default for a student's code without one, and
+ *   calls wake_up() for each process in turn.
  */
 
 static void simulate_cpus(void)
 {
-    int n;
+    sim_timer *timer;
 
-    for (n=0; n<cpu_count; n++)
+    /*
+     * Only the CPUs whose timer expires in this tick have anything to do.
+     * A process dispatched from here on is first simulated next tick.
+     */
+    timer_wheel_advance(&sim_timers, simulator_time);
+    next_cpu_tick = simulator_time + 1;
+
+    while ((timer = timer_wheel_expire(&sim_timers, cpu_count)) != NULL)
+        simulate_process(timer->key, simulator_cpu_data[timer->key].current);
+}
+
+/*
+ * arm_cpu_timer() arms a CPU's timer for the process just dispatched on it.
+ * A burst of n ticks ends in the (n+1)th tick, and a time slice of s ticks
+ * expires in the s-th tick, so the timer fires in whichever comes first.
+ * Bursts stretch when the CPU runs below its fastest frequency level, and
+ * start late by the exit latency of the idle state the CPU woke from and by
+ * the overhead of the dispatch.  A process missing pages of its working set
+ * takes the page fault in its first tick instead.
+ */
+static void arm_cpu_timer(unsigned int cpu_id)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+    pcb_t *pcb = cpu->current;
+
+    cpu->dispatched_at = next_cpu_tick + cpu->wake_latency + cpu->overhead;
+    cpu->wake_latency = 0;
+    cpu->overhead = 0;
+    cpu->burst_left = (program_op(pcb) == OP_CPU && pcb->pc.time > 0) ?
+                      pcb->pc.time : 0;
+    cpu->speed = cpu_speed(cpu_id);
+    cpu->work_carry = cpu->burst_left > 0 ? carried_work[pcb->pid] : 0;
+    if (memory_enabled())
+        cpu->page_faults = memory_touch(cpu->current->pid);
+
+    set_cpu_timer(cpu_id);
+}
+
+/*
+ * set_cpu_timer() arms a CPU's timer for the end of the burst left at
+ * dispatched_at, at the CPU's speed, or the end of its time slice.
+ */
+static void set_cpu_timer(unsigned int cpu_id)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+    unsigned int expires, ticks;
+
+    ticks = busy_ticks(cpu->speed, cpu->burst_left, cpu->work_carry);
+    if (cpu->page_faults > 0)
+        expires = cpu->dispatched_at;
+    else if (cpu->preemption_time > 0 && cpu->preemption_time <= ticks)
+        expires = cpu->dispatched_at + cpu->preemption_time - 1;
+    else
+        expires = cpu->dispatched_at + ticks;
+
+    timer_wheel_add(&sim_timers, &cpu->timer, expires, cpu_id);
+}
+
+/*
+ * cpu_speed() returns the speed a CPU runs its current process at, in
+ * 1/1000ths of a full-capacity CPU at the fastest level: its frequency
+ * level and capacity, cut to smt_throughput while its sibling is busy.
+ */
+static unsigned int cpu_speed(unsigned int cpu_id)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+    unsigned int speed = cpu_freq_speed[cpu->run_level] * cpu->capacity / 1000;
+    int sibling = get_cpu_sibling(cpu_id);
+
+    if (sibling >= 0 && (unsigned int)sibling < cpu_count &&
+        simulator_cpu_data[sibling].current != NULL)
+        speed = speed * smt_throughput / 1000;
+    return speed;
+}
+
+/*
+ * smt_shared_open() returns the ticks until now of the intervals in which
+ * both siblings of a core are still busy.
+ */
+static unsigned int smt_shared_open(unsigned int now)
+{
+    unsigned int n, ticks = 0;
+
+    if (smt_throughput == 0)
+        return 0;
+    for (n=0; n+1<cpu_count; n+=2)
+        if (simulator_cpu_data[n].current != NULL &&
+            simulator_cpu_data[n + 1].current != NULL)
+            ticks += now - smt_shared_since[n / 2];
+    return ticks;
+}
+
+/*
+ * sibling_changed() is called when a CPU becomes busy or idle.  It accounts
+ * the time both SMT siblings of its core are busy, and re-arms the timer of
+ * a sibling running a CPU burst for its new speed: the work done so far
+ * counts at the old speed, and the rest of the burst runs at the new one.
+ */
+static void sibling_changed(unsigned int cpu_id, int busy)
+{
+    int sibling = get_cpu_sibling(cpu_id);
+    simulator_cpu_data_t *cpu;
+    unsigned int elapsed, ran;
+
+    if (sibling < 0 || (unsigned int)sibling >= cpu_count)
+        return;
+    cpu = &simulator_cpu_data[sibling];
+    if (cpu->current == NULL)
+        return;
+
+    if (busy)
+        smt_shared_since[cpu_id / 2] = next_cpu_tick;
+    else
+        smt_shared_ticks += next_cpu_tick - smt_shared_since[cpu_id / 2];
+
+    if (!timer_pending(&cpu->timer) || cpu->page_faults > 0 ||
+        program_op(cpu->current) != OP_CPU)
+        return;
+    timer_wheel_cancel(&cpu->timer);
+    if ((int)(next_cpu_tick - cpu->dispatched_at) > 0)
     {
-        if (simulator_cpu_data[n].current != NULL)
-            simulate_process(n, simulator_cpu_data[n].current);
+        elapsed = next_cpu_tick - cpu->dispatched_at;
+        ran = work_done(cpu->speed, elapsed, cpu->work_carry);
+        cpu->work_carry = (elapsed * cpu->speed + cpu->work_carry) % 1000;
+        cpu->burst_left = ran < cpu->burst_left ? cpu->burst_left - ran : 0;
+        if (cpu->preemption_time > 0)
+            cpu->preemption_time = cpu->preemption_time > (int)elapsed ?
+                                   cpu->preemption_time - (int)elapsed : 1;
+        cpu->dispatched_at = next_cpu_tick;
     }
+    cpu->speed = cpu_speed(sibling);
+    set_cpu_timer(sibling);
+}
+
+/*
+ * save_progress() writes back how much of the CPU burst of a CPU's process
+ * is left after elapsed ticks of its dispatch, and keeps the work done
+ * towards its next whole tick for its next dispatch, so that a process
+ * whose time slices are shorter than a tick of work at its speed still
+ * gets through its burst.
+ */
+static void save_progress(unsigned int cpu_id, unsigned int elapsed)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+    pcb_t *pcb = cpu->current;
+    unsigned int ran;
+
+    ran = work_done(cpu->speed, elapsed, cpu->work_carry);
+    pcb->pc.time = ran < cpu->burst_left ? cpu->burst_left - ran : 0;
+    carried_work[pcb->pid] = pcb->pc.time > 0 ?
+        (elapsed * cpu->speed + cpu->work_carry) % 1000 : 0;
+}
+
+/*
+ * stop_cpu_timer() disarms a CPU's timer before its process is taken off the
+ * CPU early, and writes back how much of the CPU burst is left.
+ */
+static void stop_cpu_timer(unsigned int cpu_id)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+
+    if (!timer_pending(&cpu->timer))
+        return;
+    timer_wheel_cancel(&cpu->timer);
+    cpu->page_faults = 0;
+
+    if (program_op(cpu->current) == OP_CPU)
+        save_progress(cpu_id, (int)(next_cpu_tick - cpu->dispatched_at) > 0 ?
+                              next_cpu_tick - cpu->dispatched_at : 0);
+}
+
+/*
+ * account_energy() charges the energy of the interval a CPU is leaving when
+ * context_switch() gives it the process next (NULL for idle), and starts
+ * the next interval at the frequency level or in the idle state currently
+ * set for the CPU.
+ */
+static void account_energy(unsigned int cpu_id, pcb_t *next)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+
+    if (cpu->current != NULL)
+    {
+        energy_used += energy_busy(cpu->run_level, cpu->capacity,
+                                   next_cpu_tick - cpu->busy_since);
+    }
+    else if (next != NULL)
+    {
+        energy_used += energy_idle(next_cpu_tick - cpu->idle_since,
+                                   cpu->idle_cstate, &cpu->wake_latency);
+    }
+    else
+    {
+        /* Still idle */
+        return;
+    }
+
+    if (next != NULL)
+    {
+        cpu->busy_since = next_cpu_tick;
+        cpu->run_level = cpu->freq_level;
+    }
+    else
+    {
+        cpu->idle_since = next_cpu_tick;
+        cpu->idle_cstate = cpu->cstate;
+    }
+}
+
+/*
+ * charge_overhead() charges a CPU the overhead of dispatching the process
+ * next.  A process that last ran on another CPU migrates, which is a switch
+ * too, even back to the process the CPU ran last.  The READY count is the
+ * run queue the scheduler just picked from, less the process picked.
+ */
+static void charge_overhead(unsigned int cpu_id, pcb_t *next)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+    int migrated, switched;
+
+    if (!overhead_enabled())
+        return;
+
+    migrated = last_cpu[next->pid] >= 0 && last_cpu[next->pid] != (int)cpu_id;
+    switched = migrated || next != cpu->last_process;
+    cpu->overhead = overhead_charge(&cpu->overhead_carry, switched, migrated,
+        __atomic_load_n(&state_count[PROCESS_READY], __ATOMIC_RELAXED));
+    cpu->last_process = next;
+    last_cpu[next->pid] = cpu_id;
+}
+
+/*
+ * signal_cpu() posts an event to a CPU's mailbox, then waits until the
+ * thread has finished the handler and called context_switch(), which
+ * changes the CPU's switch count.  Each CPU has its own condition variable
+ * to wait on, so handoffs to different CPUs never wake each other's
+ * waiters; the supervisor and a CPU calling force_preempt() may still both
+ * wait for the same CPU, hence the broadcast in context_switch().
+ */
+static void signal_cpu(unsigned int cpu_id, simulator_cpu_state_t event)
+{
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+    unsigned int switches = cpu->switches;
+#ifdef LOCKSTAT
+    unsigned long long start = lockstat_now();
+    int wakeups = 0;
+#endif
+
+    cpu->state = event;
+    cpu->posted++;
+    fiber_cond_signal(&cpu->wakeup);
+    while (cpu->switches == switches)
+    {
+        LOCKSTAT_COND_WAIT(&cpu->switched, &simulator_mutex);
+#ifdef LOCKSTAT
+        wakeups++;
+#endif
+    }
+#ifdef LOCKSTAT
+    lockstat_acquired(&handoff_stat, start, wakeups > 1);
+#endif
 }
 
 static void simulate_process(unsigned int cpu_id, pcb_t *pcb)
 {
+    simulator_cpu_data_t *cpu = &simulator_cpu_data[cpu_id];
+
     /*
-     * The "program counter" is really just a pointer to the current position
-     * in the operations array
+     * The "program counter" is a cursor into the process's program, which
+     * holds the time left of the current operation; the program itself is
+     * never written
      */
-    op_t *pc = (op_t*)pcb->pc;
+    if (cpu->page_faults > 0)
+    {
+        /* Wait for the missing pages; the burst starts over afterwards */
+        submit_io_request(&paging_device, pcb,
+            (cpu->page_faults + PAGES_PER_TICK - 1) / PAGES_PER_TICK);
+        cpu->page_faults = 0;
+        signal_cpu(cpu_id, CPU_YIELD);
+        return;
+    }
 
-    switch (pc->type)
+    switch (program_op(pcb))
     {
     case OP_CPU:
         /* Scheduling a running process ... good ... */
 
-        /* Check to see if the CPU burst has completed */
-        if (pc->time > 0)
+        /* Check to see if the time slice ran out before the CPU burst */
+        if (cpu->preemption_time > 0 && cpu->preemption_time <=
+            busy_ticks(cpu->speed, cpu->burst_left, cpu->work_carry))
         {
             /* Simulate running the process */
-            pc->time--;
+            save_progress(cpu_id, cpu->preemption_time);
 
-            /* Simulate the preemption timer */
-            simulator_cpu_data[cpu_id].preemption_timer--;
-            if (simulator_cpu_data[cpu_id].preemption_timer == 0)
-            {
-                /* The timer has expired; preempt the running process */
-                simulator_cpu_data[cpu_id].state = CPU_PREEMPT;
-                pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-				// wait to make sure thread finishes preempt and context switch
-				pthread_cond_wait(&thread_yielded, &simulator_mutex);
-            }
+            /* The timer has expired; preempt the running process */
+            signal_cpu(cpu_id, CPU_PREEMPT);
         }
         else
         {
             /* Move to the next operation */
-            pcb->pc=((op_t*)(pcb->pc))+1;
-			pc++;
+            carried_work[pcb->pid] = 0;
+            program_next(pcb);
+            if (!run_instant_ops(pcb))
+            {
+                /* Wait for the lock like for I/O */
+                signal_cpu(cpu_id, CPU_YIELD);
+                break;
+            }
 
-            switch (pc->type)
+            switch (program_op(pcb))
             {
             case OP_IO:
                 /* Put a request in the I/O FIFO queue */
-                submit_io_request(pcb, pc->time);
+                submit_io_request(&disk, pcb, pcb->pc.time);
 
                 /* Generate a yield() call on the appropriate CPU */
-                simulator_cpu_data[cpu_id].state = CPU_YIELD;
-                pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-				// wait to make sure thread finishes yield and context switch
-				pthread_cond_wait(&thread_yielded, &simulator_mutex);
+                signal_cpu(cpu_id, CPU_YIELD);
                 break;
 
             case OP_TERMINATE:
                 /* Generate a terminate() call on the appropriate CPU */
-                simulator_cpu_data[cpu_id].state = CPU_TERMINATE;
-                pthread_cond_signal(&simulator_cpu_data[cpu_id].wakeup);
-				// wait to make sure thread finishes terminate and context switch
-				pthread_cond_wait(&thread_yielded, &simulator_mutex);
+                memory_release(pcb->pid);
+                arrival_done(pcb->pid, simulator_time);
+                signal_cpu(cpu_id, CPU_TERMINATE);
+                break;
+
+            case OP_MEM:
+            case OP_ACQUIRE:
+            case OP_RELEASE:
+            case OP_REPEAT:
+                /* run_instant_ops() and program_next() have run these */
                 break;
 
             case OP_CPU:
+                /* Keep running on what is left of the time slice */
+                if (cpu->preemption_time > 0)
+                    cpu->preemption_time -= busy_ticks(cpu->speed,
+                        cpu->burst_left, cpu->work_carry);
+                arm_cpu_timer(cpu_id);
                 break;
             }
         }
@@ -523,10 +1442,69 @@ static void simulate_process(unsigned int cpu_id, pcb_t *pcb)
         /* Scheduling a process that's terminated */
         printf("Scheduled a terminated process! PID: %d\n", pcb->pid);
         break;
+
+    default:
+        break;
     }
 }
 
-static void submit_io_request(pcb_t *pcb, unsigned int execution_time)
+/*
+ * A process handed a lock by a release runs on from its OP_ACQUIRE, and is
+ * woken up in simulate_locks() unless it blocks again.
+ */
+static int run_instant_ops(pcb_t *pcb)
+{
+    pcb_t *next;
+
+    for (;; program_next(pcb))
+    {
+        switch (program_op(pcb))
+        {
+        case OP_MEM:
+            if (memory_enabled())
+                memory_set_working_set(pcb->pid, pcb->pc.time);
+            break;
+
+        case OP_ACQUIRE:
+            if (sync_enabled() &&
+                !sync_acquire(pcb, pcb->pc.time, simulator_time))
+                return 0;
+            break;
+
+        case OP_RELEASE:
+            if (!sync_enabled())
+                break;
+            next = sync_release(pcb, pcb->pc.time, simulator_time);
+            if (next != NULL)
+            {
+                program_next(next);
+                if (run_instant_ops(next))
+                    lock_wakeups[lock_wakeup_count++] = next;
+            }
+            break;
+
+        default:
+            return 1;
+        }
+    }
+}
+
+static void submit_io_request(io_device *device, pcb_t *pcb,
+                              unsigned int execution_time)
+{
+    io_request *r;
+
+    r = queue_io_request(device, pcb, execution_time);
+    if (disk_enabled())
+        disk_address(&device->model, &r->io, pcb->pid, device == &disk);
+
+    /* The device is free; the request completes after execution_time */
+    if (device->head == r)
+        start_io_request(device, simulator_time);
+}
+
+static io_request *queue_io_request(io_device *device, pcb_t *pcb,
+                                    unsigned int execution_time)
 {
     io_request *r;
 
@@ -535,71 +1513,544 @@ static void submit_io_request(pcb_t *pcb, unsigned int execution_time)
     assert(r != NULL);
     r->pcb = pcb;
     r->execution_time = execution_time;
+    r->io.block = 0;
+    r->io.submitted = simulator_time;
+    r->io.write = 0;
+    r->timer.next = NULL;
     r->next = NULL;
+    device->length++;
 
     /* Add request to end of queue */
-    if (io_queue_tail != NULL)
+    if (device->tail != NULL)
+        device->tail->next = r;
+    else
+        device->head = r;
+    device->tail = r;
+    return r;
+}
+
+static void start_io_request(io_device *device, unsigned int start)
+{
+    disk_request_t *queued[PROCESS_COUNT];
+    io_request *r, *prev = NULL;
+    unsigned int count = 0, pick, ticks;
+
+    if (disk_enabled())
+    {
+        for (r = device->head; r != NULL && count < PROCESS_COUNT; r = r->next)
+            queued[count++] = &r->io;
+        pick = disk_pick(&device->model, queued, count, simulator_time);
+
+        /* Move the request picked to the head */
+        for (r = device->head; pick > 0; pick--)
+        {
+            prev = r;
+            r = r->next;
+        }
+        if (prev != NULL)
+        {
+            prev->next = r->next;
+            if (device->tail == r)
+                device->tail = prev;
+            r->next = device->head;
+            device->head = r;
+        }
+        ticks = disk_start(&device->model, &r->io, r->execution_time);
+    }
+    else
+        ticks = device->head->execution_time;
+
+    timer_wheel_add(&sim_timers, &device->head->timer, start + ticks,
+                    device->timer_key);
+}
+
+static void simulate_io(io_device *device)
+{
+    io_request *completed;
+    sim_timer *timer;
+    pcb_t *pcb;
+
+    timer = timer_wheel_expire(&sim_timers, device->timer_key + 1);
+    if (timer == NULL)
+        return; /* No I/O request completes in this tick */
+    assert(timer->key == device->timer_key);
+
+    completed = device->head;
+    pcb = completed->pcb;
+
+    if (device == &paging_device)
+    {
+        /* The missing pages are in; the process can run its burst */
+        memory_load(pcb->pid);
+        paging_wait_counter += simulator_time - completed->io.submitted;
+    }
+    else
     {
-        io_queue_tail->next = r;
-        io_queue_tail = r;
+        /* Move the programs "PC" to the next "instruction" */
+        program_next(pcb);
+        if (!run_instant_ops(pcb))
+            pcb = NULL; /* Blocked on a lock */
     }
+
+    /* The next request starts next tick */
+    if (disk_enabled())
+        disk_done(&device->model, &completed->io, simulator_time);
+    device->head = completed->next;
+    device->length--;
+    if (device->head == NULL)
+        device->tail = NULL;
     else
+        start_io_request(device, simulator_time + 1);
+    free(completed);
+    if (pcb != NULL)
+        queue_wakeup(pcb);
+}
+
+static void simulate_locks(void)
+{
+    unsigned int n;
+
+    for (n=0; n<lock_wakeup_count; n++)
+        queue_wakeup(lock_wakeups[n]);
+    lock_wakeup_count = 0;
+}
+
+static void simulate_policy_timer(void)
+{
+    if (timer_wheel_expire(&sim_timers, TIMER_KEY_POLICY + 1) == NULL)
+        return;
+
+    /* Call the student's policy_timer() handler */
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
+    IRWL_WRITER_LOCK(student_lock);
+    policy_timer();
+    IRWL_WRITER_UNLOCK(student_lock);
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
+}
+
+static void simulate_creat(void)
+{
+    /*
+     * Arrivals are sorted, so the processes due are the next ones in
+     * processes[].
+     */
+    while (processes_created < PROCESS_COUNT &&
+           arrival_ticks[processes_created] <= simulator_time)
     {
-        io_queue_head = r;
-        io_queue_tail = r;
+        /* A process that waits for a lock from the start is WAITING */
+        if (run_instant_ops(&processes[processes_created]))
+            queue_wakeup(&processes[processes_created]);
+        else
+            set_process_state(&processes[processes_created], PROCESS_WAITING);
+        processes_created++;
     }
 }
 
-static void simulate_io(void)
+static void queue_wakeup(pcb_t *pcb)
 {
-    if (io_queue_head == NULL)
-        return; /* There are no I/O requests */
+    /* A process is woken up at most once a tick */
+    assert(tick_wakeup_count < PROCESS_COUNT);
+    tick_wakeups[tick_wakeup_count++] = pcb;
+}
+
+static void deliver_wakeups(void)
+{
+    pcb_t *changed[PROCESS_COUNT + 1];
+    unsigned int priorities[PROCESS_COUNT + 1];
+    unsigned int count = tick_wakeup_count, changes = 0, n;
+
+    while ((changed[changes] =
+            sync_next_inherited(&priorities[changes])) != NULL)
+        changes++;
+    if (count == 0 && changes == 0)
+        return;
+    tick_wakeup_count = 0;
 
-    if (io_queue_head->execution_time-- <= 0)
+    /*
+     * The list is cleared before the locks are dropped: only the supervisor
+     * queues wake-ups, so nothing is added to it meanwhile.  Handlers run
+     * concurrently, idle() without the student_lock, so the inherited
+     * priorities are changed atomically, like the process state.
+     */
+    LOCKSTAT_MUTEX_UNLOCK(&simulator_mutex);
+    IRWL_WRITER_LOCK(student_lock);
+    for (n=0; n<changes; n++)
     {
-        io_request *completed = io_queue_head;
-        pcb_t *pcb;
+        __atomic_store_n(&changed[n]->inherited_priority, priorities[n],
+                         __ATOMIC_RELAXED);
+        priority_changed(changed[n]);
+    }
+    if (count == 1)
+        wake_up(tick_wakeups[0]);
+    else if (count > 1)
+        wake_up_batch(tick_wakeups, count);
+    IRWL_WRITER_UNLOCK(student_lock);
+    LOCKSTAT_MUTEX_LOCK(&simulator_mutex);
+}
 
-        /* Move the programs "PC" to the next "instruction" */
-        completed->pcb->pc = ((op_t*)completed->pcb->pc) + 1;
-        
-        /*
-         * Remove the I/O request from the queue before calling the student's
-         * code.  We must do this, because once we release the simulator_mutex,
-         * the I/O queue may have changed.
-         */
-        pcb = completed->pcb;
-        io_queue_head = completed->next;
-        if (io_queue_head == NULL)
-            io_queue_tail = NULL;
-        free(completed);
-
-        /* Call the student's wake_up() handler */
-        pthread_mutex_unlock(&simulator_mutex);
-        IRWL_WRITER_LOCK(student_lock);
-        wake_up(pcb);
-        IRWL_WRITER_UNLOCK(student_lock);
-        pthread_mutex_lock(&simulator_mutex);
+__attribute__((weak))
+extern void wake_up_batch(pcb_t **processes, unsigned int count)
+{
+    unsigned int n;
+
+    for (n=0; n<count; n++)
+        wake_up(processes[n]);
+}
+
+
+
+
+/*
+ * Checkpoints hold the simulator state at the start of a tick, before the
+ * Gantt line is printed.  The student's scheduler state is not part of it:
+ * on restore, the processes that were running or READY are handed to
+ * wake_up_batch() again, those that were on a CPU first, then the READY
+ * ones in the order they became READY.  A checkpoint can therefore be
+ * restored under any scheduler; a process that was on a CPU keeps what was
+ * left of its CPU burst, but not of its time slice.
+ *
+ * request_checkpoint() is the SIGUSR1 handler; the checkpoint is taken at
+ *   the start of the next tick.
+ *
+ * save_checkpoint() / save_device() write the simulator state to the
+ *   checkpoint file, with the student_lock held, so that no handler is
+ *   halfway through changing a process's state.  A process idle() is
+ *   dispatching is saved as READY or RUNNING, and is handed back either way.
+ *
+ * restore_checkpoint() / restore_device() replace the initial state with
+ *   the one in the checkpoint, before the CPU threads start.
+ *
+ * resume_processes() hands the processes that were running or READY to
+ *   wake_up_batch().
+ */
+static void request_checkpoint(int signal)
+{
+    checkpoint_requested = 1;
+}
+
+static void save_checkpoint(void)
+{
+    simulator_cpu_data_t *cpu;
+    pcb_t *order[PROCESS_COUNT], *pcb;
+    char listed[PROCESS_COUNT];
+    unsigned int count = 0, n, m, ran, elapsed, carry, busy, pending, shared;
+    program_cursor_t pc;
+    process_state_t state;
+    int last_pid;
+
+    if (checkpoint_create(checkpoint_path) < 0)
+        return;
+    IRWL_READER_LOCK(student_lock)
+
+    CHECKPOINT_PUT(cpu_count);
+    CHECKPOINT_PUT(simulator_time);
+    CHECKPOINT_PUT(processes_created);
+    CHECKPOINT_PUT(processes_terminated);
+    CHECKPOINT_PUT(context_switches);
+    CHECKPOINT_PUT(ready_counter);
+    CHECKPOINT_PUT(running_counter);
+    CHECKPOINT_PUT(waiting_counter);
+    CHECKPOINT_PUT(idle_ready_counter);
+    CHECKPOINT_PUT(paging_wait_counter);
+    CHECKPOINT_PUT(energy_used);
+    CHECKPOINT_PUT(cstate_ticks);
+    pending = timer_pending(&policy_timer_event);
+    CHECKPOINT_PUT(pending);
+    CHECKPOINT_PUT(policy_timer_event.expires);
+    CHECKPOINT_PUT(last_cpu);
+    shared = smt_shared_ticks + smt_shared_open(simulator_time);
+    CHECKPOINT_PUT(shared);
+
+    /* The processes on a CPU are handed back first */
+    for (n=0; n<PROCESS_COUNT; n++)
+        listed[n] = 0;
+    for (n=0; n<cpu_count; n++)
+    {
+        cpu = &simulator_cpu_data[n];
+        busy = cpu->current != NULL;
+        CHECKPOINT_PUT(cpu->freq_level);
+        CHECKPOINT_PUT(cpu->run_level);
+        CHECKPOINT_PUT(cpu->busy_since);
+        CHECKPOINT_PUT(cpu->idle_since);
+        CHECKPOINT_PUT(cpu->cstate);
+        CHECKPOINT_PUT(cpu->idle_cstate);
+        CHECKPOINT_PUT(cpu->wake_latency);
+        CHECKPOINT_PUT(cpu->switches);
+        last_pid = cpu->last_process != NULL ? (int)cpu->last_process->pid : -1;
+        CHECKPOINT_PUT(last_pid);
+        CHECKPOINT_PUT(cpu->overhead_carry);
+        CHECKPOINT_PUT(busy);
+        if (busy)
+        {
+            order[count++] = cpu->current;
+            listed[cpu->current->pid] = 1;
+        }
     }
+
+    /* Then the ones being dispatched, then the READY ones, oldest first */
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        if (!listed[n] && processes[n].state == PROCESS_RUNNING)
+        {
+            order[count++] = &processes[n];
+            listed[n] = 1;
+        }
+    }
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        if (listed[n] || processes[n].state != PROCESS_READY)
+            continue;
+        for (m = count; m > 0 && order[m - 1]->state == PROCESS_READY &&
+             (int)(ready_order[order[m - 1]->pid] - ready_order[n]) > 0; m--)
+            order[m] = order[m - 1];
+        order[m] = &processes[n];
+        count++;
+        listed[n] = 1;
+    }
+    for (n=0; n<lock_wakeup_count; n++)
+    {
+        if (!listed[lock_wakeups[n]->pid])
+        {
+            order[count++] = lock_wakeups[n];
+            listed[lock_wakeups[n]->pid] = 1;
+        }
+    }
+
+    /*
+     * A process's program counter is saved as its cursor, with the time left
+     * of its operation and the work carried towards its next tick, which for
+     * a process on a CPU are what stop_cpu_timer() would write back now.
+     */
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        pcb = &processes[n];
+        state = pcb->state;
+        pc = pcb->pc;
+        carry = carried_work[n];
+        for (m=0; m<cpu_count; m++)
+        {
+            cpu = &simulator_cpu_data[m];
+            if (cpu->current != pcb || cpu->page_faults > 0 ||
+                program_op(pcb) != OP_CPU)
+                continue;
+            elapsed = (int)(simulator_time - cpu->dispatched_at) > 0 ?
+                      simulator_time - cpu->dispatched_at : 0;
+            ran = work_done(cpu->speed, elapsed, cpu->work_carry);
+            pc.time = ran < cpu->burst_left ? cpu->burst_left - ran : 0;
+            carry = pc.time > 0 ?
+                    (elapsed * cpu->speed + cpu->work_carry) % 1000 : 0;
+        }
+        CHECKPOINT_PUT(state);
+        CHECKPOINT_PUT(pc);
+        CHECKPOINT_PUT(carry);
+        CHECKPOINT_PUT(pcb->inherited_priority);
+    }
+    CHECKPOINT_PUT(count);
+    for (n=0; n<count; n++)
+        CHECKPOINT_PUT(order[n]->pid);
+
+    IRWL_READER_UNLOCK(student_lock)
+
+    save_device(&disk);
+    save_device(&paging_device);
+    memory_save();
+    sync_save();
+    arrival_save();
+    overhead_save();
+
+    if (checkpoint_close() < 0)
+        fprintf(stderr, "%s: checkpoint at %.1f s failed\n", checkpoint_path,
+            (float)simulator_time / 10.0);
 }
 
-static void simulate_creat(void)
+/*
+ * The request at the head of the queue is saved with the time left until
+ * its timer expires, so that it is re-armed for the same tick without
+ * seeking again.
+ */
+static void save_device(io_device *device)
 {
-    static int processes_created = 0;
+    io_request *r;
+    unsigned int left;
 
-    if ((simulator_time % 10) == 0 && processes_created < PROCESS_COUNT)
+    CHECKPOINT_PUT(device->length);
+    for (r = device->head; r != NULL; r = r->next)
     {
-        /* Call student's wake_up() handler */
-        pthread_mutex_unlock(&simulator_mutex);
-        IRWL_WRITER_LOCK(student_lock);
-        wake_up(&processes[processes_created]);
-        IRWL_WRITER_UNLOCK(student_lock);
-        pthread_mutex_lock(&simulator_mutex);
+        left = r == device->head ? r->timer.expires - simulator_time :
+               r->execution_time;
+        CHECKPOINT_PUT(r->pcb->pid);
+        CHECKPOINT_PUT(left);
+        CHECKPOINT_PUT(r->io);
+    }
+    disk_save(&device->model);
+}
 
-        processes_created++;
+static void restore_checkpoint(void)
+{
+    simulator_cpu_data_t *cpu;
+    unsigned int saved_cpus, pending, expires, busy, pid, n;
+    process_state_t state;
+    int last_pid;
+
+    if (checkpoint_open(restore_path) < 0)
+        exit(-1);
+
+    CHECKPOINT_GET(saved_cpus);
+    if (saved_cpus != cpu_count)
+    {
+        fprintf(stderr, "%s was saved with %u CPUs\n\n", restore_path,
+            saved_cpus);
+        exit(-1);
+    }
+    CHECKPOINT_GET(simulator_time);
+    CHECKPOINT_GET(processes_created);
+    CHECKPOINT_GET(processes_terminated);
+    CHECKPOINT_GET(context_switches);
+    CHECKPOINT_GET(ready_counter);
+    CHECKPOINT_GET(running_counter);
+    CHECKPOINT_GET(waiting_counter);
+    CHECKPOINT_GET(idle_ready_counter);
+    CHECKPOINT_GET(paging_wait_counter);
+    CHECKPOINT_GET(energy_used);
+    CHECKPOINT_GET(cstate_ticks);
+    timer_wheel_init(&sim_timers, simulator_time);
+    next_cpu_tick = simulator_time;
+    CHECKPOINT_GET(pending);
+    CHECKPOINT_GET(expires);
+    if (!checkpoint_check(!pending ||
+                          expires - simulator_time < TIMER_WHEEL_SPAN))
+        pending = 0;
+    if (pending)
+        timer_wheel_add(&sim_timers, &policy_timer_event, expires,
+                        TIMER_KEY_POLICY);
+    CHECKPOINT_GET(last_cpu);
+    CHECKPOINT_GET(smt_shared_ticks);
+    for (n=0; n<PROCESS_COUNT; n++)
+        if (!checkpoint_check(last_cpu[n] >= -1 &&
+                              last_cpu[n] < (int)cpu_count))
+            last_cpu[n] = -1;
+
+    /* Every CPU starts idle; a busy one is charged for its busy interval */
+    for (n=0; n<cpu_count; n++)
+    {
+        cpu = &simulator_cpu_data[n];
+        CHECKPOINT_GET(cpu->freq_level);
+        CHECKPOINT_GET(cpu->run_level);
+        CHECKPOINT_GET(cpu->busy_since);
+        CHECKPOINT_GET(cpu->idle_since);
+        CHECKPOINT_GET(cpu->cstate);
+        CHECKPOINT_GET(cpu->idle_cstate);
+        CHECKPOINT_GET(cpu->wake_latency);
+        CHECKPOINT_GET(cpu->switches);
+        CHECKPOINT_GET(last_pid);
+        CHECKPOINT_GET(cpu->overhead_carry);
+        CHECKPOINT_GET(busy);
+        if (!checkpoint_check(last_pid >= -1 && last_pid < PROCESS_COUNT))
+            last_pid = -1;
+        cpu->last_process = last_pid >= 0 ? &processes[last_pid] : NULL;
+        if (!checkpoint_check(cpu->freq_level < CPU_FREQ_LEVELS))
+            cpu->freq_level = 0;
+        if (!checkpoint_check(cpu->run_level < CPU_FREQ_LEVELS))
+            cpu->run_level = 0;
+        if (!checkpoint_check(cpu->cstate < CSTATE_COUNT))
+            cpu->cstate = 0;
+        if (!checkpoint_check(cpu->idle_cstate < CSTATE_COUNT))
+            cpu->idle_cstate = 0;
+        if (busy)
+        {
+            energy_used += energy_busy(cpu->run_level, cpu->capacity,
+                                       simulator_time - cpu->busy_since);
+            cpu->idle_since = simulator_time;
+            cpu->wake_latency = 0;
+        }
+    }
+
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        CHECKPOINT_GET(state);
+        CHECKPOINT_GET(processes[n].pc);
+        CHECKPOINT_GET(carried_work[n]);
+        CHECKPOINT_GET(processes[n].inherited_priority);
+        if (!checkpoint_check(state <= PROCESS_TERMINATED))
+            state = PROCESS_NEW;
+        if (!checkpoint_check(program_valid(&processes[n])))
+            program_reset(&processes[n]);
+        checkpoint_check(carried_work[n] < 1000);
+        processes[n].state = state;
+    }
+
+    /* The processes handed back are waiting until resume_processes() */
+    CHECKPOINT_GET(resumed_count);
+    if (!checkpoint_check(resumed_count <= PROCESS_COUNT))
+        resumed_count = 0;
+    for (n=0; n<resumed_count; n++)
+    {
+        CHECKPOINT_GET(pid);
+        if (!checkpoint_check(pid < PROCESS_COUNT))
+            pid = 0;
+        resumed[n] = &processes[pid];
+        resumed[n]->state = PROCESS_WAITING;
+    }
+    for (n=0; n<=PROCESS_TERMINATED; n++)
+        state_count[n] = 0;
+    for (n=0; n<PROCESS_COUNT; n++)
+        state_count[processes[n].state]++;
+
+    restore_device(&disk);
+    restore_device(&paging_device);
+    memory_restore();
+    sync_restore();
+    arrival_restore();
+    overhead_restore();
+
+    if (checkpoint_close() < 0)
+    {
+        fprintf(stderr, "%s: checkpoint is truncated or invalid\n",
+            restore_path);
+        exit(-1);
+    }
+    printf("Restored %s at %.1f s\n\n", restore_path,
+        (float)simulator_time / 10.0);
+}
+
+static void restore_device(io_device *device)
+{
+    io_request *r;
+    unsigned int length, pid, left, head_left = 0, n;
+
+    CHECKPOINT_GET(length);
+    if (!checkpoint_check(length <= PROCESS_COUNT))
+        length = 0;
+    for (n=0; n<length; n++)
+    {
+        CHECKPOINT_GET(pid);
+        CHECKPOINT_GET(left);
+        if (!checkpoint_check(pid < PROCESS_COUNT))
+            pid = 0;
+        if (!checkpoint_check(left < TIMER_WHEEL_SPAN))
+            left = 0;
+        r = queue_io_request(device, &processes[pid], left);
+        CHECKPOINT_GET(r->io);
+        if (n == 0)
+            head_left = left;
     }
+    disk_restore(&device->model);
+    if (device->head != NULL)
+        timer_wheel_add(&sim_timers, &device->head->timer,
+                        simulator_time + head_left, device->timer_key);
 }
 
+static void resume_processes(void)
+{
+    if (resumed_count == 0)
+        return;
+
+    /* Call the student's wake_up_batch() handler */
+    IRWL_WRITER_LOCK(student_lock);
+    wake_up_batch(resumed, resumed_count);
+    IRWL_WRITER_UNLOCK(student_lock);
+    resumed_count = 0;
+}
 
 
 /* Cheap hack -- passing an int through a void pointer */
@@ -38,21 +38,54 @@ typedef enum {
  *        10 = highest priority; read-only)
  *
  *   state : The current state of the process.  This should be updated by the
- *        student's code in each of the handlers.  See the task_state_t
- *        struct above for possible values.
+ *        student's code in each of the handlers, with set_process_state().
+ *        See the task_state_t struct above for possible values.
  *
- *   pc : The "program counter" of the process.  This value is actually used
- *        by the simulator to simulate the process.  Do not touch.
+ *   program : The process's program, packed (see program.h).  (read-only)
  *
  *   next : An unused pointer to another PCB.  You may use this pointer to
  *        build a linked-list of PCBs.
+ *
+ *   group : The process group the process belongs to, for gang scheduling.
+ *        Processes in the same group cooperate and should run at the same
+ *        time.  0 means the process is not part of a group.  (read-only)
+ *
+ *   cgroup : The index in cgroups[] of the scheduling group the process is
+ *        accounted to.  (read-only)
+ *
+ *   inherited_priority : The highest priority of the processes waiting for
+ *        a simulated mutex the process holds, 0 if none.  It is set by the
+ *        simulator, which calls priority_changed() when it changes; as that
+ *        may happen while other handlers run, read it with
+ *        __atomic_load_n().  (read-only)
+ *
+ *   pc : The "program counter" of the process.  This value is actually used
+ *        by the simulator to simulate the process.  Do not touch.
+ *
+ * A process's program is a sequence of operations.  OP_MEM sets the working
+ * set, in pages, touched by the CPU bursts after it.  OP_ACQUIRE and
+ * OP_RELEASE take and give back a unit of the simulated lock locks[time];
+ * a process that can't take it yields the CPU and waits until it is handed
+ * the lock.  These three take no time, and the last two are skipped unless
+ * set_lock_workload() was called.  OP_REPEAT is not an operation but
+ * repeats the ones before it (see program.h).
  */
-typedef enum { OP_CPU = 0, OP_IO, OP_TERMINATE } op_type;
+typedef enum {
+    OP_CPU = 0, OP_IO, OP_TERMINATE, OP_MEM, OP_ACQUIRE, OP_RELEASE, OP_REPEAT
+} op_type;
 
+typedef unsigned short program_word_t;
+
+/*
+ * A process's place in its program: the word of its current operation, the
+ * passes made over the run of operations being repeated, and the time left
+ * of the current operation.
+ */
 typedef struct {
-    op_type type;
+    unsigned short index;
+    unsigned short pass;
     int time;
-} op_t;
+} program_cursor_t;
 
 
 typedef struct _pcb_t {
@@ -60,18 +93,152 @@ typedef struct _pcb_t {
     const char *name;
     const unsigned int static_priority;
     process_state_t state;
-    op_t *pc;
+    const program_word_t *const program;
     struct _pcb_t *next;
+    const unsigned int group;
+    const unsigned int cgroup;
+    unsigned int inherited_priority;
+    program_cursor_t pc;
 } pcb_t;
 
 
 /*
- * start_simulator() runs the OS simulation.  The number of CPUs (1-16) should
- * be passed as the parameter.
+ * A scheduling group, for hierarchical CPU shares and quotas.  Scheduling
+ * groups form a tree rooted at cgroups[0]; processes belong to the leaves.
+ *
+ *   name   : A string naming the group, e.g. "/batch/db".
+ *
+ *   parent : The index of the parent group in cgroups[], -1 for the root.
+ *
+ *   weight : The group's share of the CPU time relative to its siblings.
+ *
+ *   quota, period : The group's subtree may use at most quota ticks of CPU
+ *        time (across all CPUs) in every period ticks.  A quota of 0 means
+ *        the group is not limited.
+ */
+typedef struct {
+    const char *name;
+    const int parent;
+    const unsigned int weight;
+    const unsigned int quota;
+    const unsigned int period;
+} cgroup_t;
+
+
+/*
+ * A simulated lock shared between processes: a semaphore of count units,
+ * or a mutex if count is 1.
+ */
+typedef struct {
+    const char *name;
+    const unsigned int count;
+} sim_lock_t;
+
+
+/*
+ * start_simulator() runs the OS simulation.  The number of CPUs (1-64, or
+ * 1-16384 with fibers) should be passed as the parameter.
  */
 extern void start_simulator(unsigned int cpu_count);
 
 
+/*
+ * set_process_state() changes the state of a process.  The simulator keeps
+ * count of the processes in each state as they change, rather than looking
+ * at every PCB on every tick, so the state must not be assigned directly.
+ */
+extern void set_process_state(pcb_t *pcb, process_state_t state);
+
+
+/*
+ * set_metrics_name() publishes live metrics in the POSIX shared memory
+ * object name, for os-stat to poll (see metrics.h).  It must be called
+ * before start_simulator(), and returns -1 if the object can't be created.
+ */
+extern int set_metrics_name(const char *name);
+
+
+/*
+ * set_checkpoint() saves the simulator state to the file path at the start
+ * of the given tick (0 for none), and of the next tick whenever the
+ * simulator receives SIGUSR1; the simulation goes on afterwards.
+ *
+ * set_restore() starts the simulation from the state saved in the file path
+ * instead of from the beginning.  The processes that were running or READY
+ * are handed to wake_up_batch() before the first tick, so the student's
+ * code starts from empty queues and may use any scheduler.  The checkpoint's
+ * memory and arrivals replace the ones selected, and it must have been
+ * saved with the same number of CPUs.
+ *
+ * Both must be called before start_simulator().
+ */
+extern void set_checkpoint(const char *path, unsigned int tick);
+extern void set_restore(const char *path);
+
+
+/*
+ * set_overhead_model() charges the CPUs for switches, migrations and
+ * scheduler decisions with the costs in spec (see overhead.h).  It must be
+ * called before start_simulator(), and returns -1 if spec is not valid.
+ */
+extern int set_overhead_model(const char *spec);
+
+
+/*
+ * set_disk_model() gives the disk and the paging device a head that seeks
+ * to each request's block, served in the order of the I/O scheduler in
+ * spec (see disk.h).  It must be called before start_simulator(), and
+ * returns -1 if spec is not valid.
+ */
+extern int set_disk_model(const char *spec);
+
+
+/*
+ * set_fiber_workers() runs the CPUs as fibers on the given number of worker
+ * threads, rather than each on a thread of its own (see fiber.h), which
+ * lets the simulator run thousands of CPUs.  It must be called before
+ * start_simulator(), and returns -1 if workers is 0.  The student's code
+ * must then only block in LOCKSTAT_COND_WAIT() on a fiber_cond_t.
+ */
+extern int set_fiber_workers(unsigned int workers);
+
+
+/*
+ * set_timeline() records every tick's line of the Gantt chart in the file
+ * path, in the columnar format of timeline.h, for os-timeline to analyse.
+ * It must be called before start_simulator(), which exits if the file can't
+ * be created.
+ */
+extern void set_timeline(const char *path);
+
+
+/*
+ * set_memory_frames() turns on the paged memory model with the given number
+ * of physical frames.  It must be called before start_simulator().  A
+ * process dispatched with part of its working set not resident yields the
+ * CPU and waits for the paging device; yield() can't tell this from I/O.
+ */
+extern void set_memory_frames(unsigned int frames);
+
+
+/*
+ * set_lock_workload() makes the processes take the simulated locks in
+ * locks[] as their programs say.  It must be called before
+ * start_simulator().  A process that can't take a lock yields the CPU and
+ * waits until it is handed the lock; yield() can't tell this from I/O.
+ */
+extern void set_lock_workload(void);
+
+
+/*
+ * set_arrival_model() selects how processes arrive, drawing random arrivals
+ * from seed (see arrival.h for the models).  It must be called before
+ * start_simulator(), and returns -1 if spec is not valid.  By default one
+ * process arrives every second.
+ */
+extern int set_arrival_model(const char *spec, unsigned int seed);
+
+
 /*
  * context_switch() schedules a process on a CPU.  Note that it is
  * non-blocking.  It does not actually simulate the execution of the process;
@@ -95,6 +262,84 @@ extern void context_switch(unsigned int cpu_id, pcb_t *pcb,
 extern void force_preempt(unsigned int cpu_id);
 
 
+/*
+ * Each CPU can run at one of CPU_FREQ_LEVELS frequency levels.  Level 0 is
+ * the fastest; cpu_freq_speed[] gives the speed of each level in 1/1000ths of
+ * the fastest one.  A CPU burst of n ticks takes n * 1000 / speed ticks.
+ *
+ * set_cpu_frequency() selects the level a CPU runs the next process
+ * dispatched on it at.  CPUs start at level 0.
+ */
+#define CPU_FREQ_LEVELS 4
+extern const unsigned int cpu_freq_speed[CPU_FREQ_LEVELS];
+
+extern void set_cpu_frequency(unsigned int cpu_id, unsigned int level);
+
+/*
+ * set_idle_state() selects the idle state (see energy.h) a CPU enters at
+ * once the next time it goes idle, from which it sinks to the deeper ones
+ * by their residency.  CPUs start with state 0, and so sink through all of
+ * them.
+ */
+extern void set_idle_state(unsigned int cpu_id, unsigned int cstate);
+
+
+/*
+ * CPUs may differ in capacity, as the big and little cores of a mobile SoC
+ * do.  A CPU's capacity is its speed at level 0 in 1/1000ths of the fastest
+ * kind of CPU, from CPU_CAPACITY_MIN to 1000, and scales its speed at every
+ * level and its power while busy.
+ *
+ * set_cpu_capacities() sets the capacities from a comma-separated list, in
+ * order of CPU id, the last one repeated for the remaining CPUs ("1000,400"
+ * makes CPU 0 big and the others little).  It must be called before
+ * start_simulator(), and returns -1 if spec is not valid.  By default every
+ * CPU has capacity 1000.
+ *
+ * get_cpu_capacity() returns the capacity of a CPU.
+ */
+#define CPU_CAPACITY_MIN 100
+
+extern int set_cpu_capacities(const char *spec);
+extern unsigned int get_cpu_capacity(unsigned int cpu_id);
+
+
+/*
+ * With SMT, CPUs 2n and 2n+1 are hyperthread siblings sharing a core.
+ * While both are busy, each runs at throughput/1000 of its speed, from
+ * SMT_THROUGHPUT_MIN to 1000; a burst speeds up again as soon as its
+ * sibling goes idle.
+ *
+ * set_smt_throughput() turns SMT on.  It must be called before
+ * start_simulator(), and returns -1 if throughput is not valid.
+ *
+ * get_cpu_sibling() returns the id of a CPU's sibling, which is past the
+ * last CPU for the last of an odd number of CPUs, or -1 without SMT.
+ */
+#define SMT_THROUGHPUT_MIN 100
+
+extern int set_smt_throughput(unsigned int throughput);
+extern int get_cpu_sibling(unsigned int cpu_id);
+
+
+/*
+ * set_policy_timer() asks the simulator to call the student's policy_timer()
+ * handler in the given tick.  Only the earliest pending request is kept.
+ */
+extern void set_policy_timer(unsigned int tick);
+
+
+/*
+ * get_simulator_time() returns the current simulated time in ticks: the next
+ * tick in which the CPUs will be simulated, which is the first tick of a
+ * time slice given to context_switch() now.  The difference between the
+ * times read when a process is dispatched and when it leaves the CPU is the
+ * number of ticks it held the CPU.  It may be called from any of the
+ * student's handlers.
+ */
+extern unsigned int get_simulator_time(void);
+
+
 /*
  * mt_safe_usleep() is a thread-safe implementation of the usleep() function.
  * See man usleep(3) for the behavior of this function.
@@ -0,0 +1,157 @@
+/*
+ * os-stat.c
+ * Multithreaded OS Simulation - live metrics reader
+ *
+ * Polls the metrics a running simulator publishes with "-P <name>", and
+ * prints a line of rates every interval:
+ *
+ *   ./os-stat <name> [ <interval in ms> ]
+ *
+ * It stops when the simulation ends, or with an error when the simulator
+ * has exited without ending it or published nothing for STALL_MS.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "metrics.h"
+
+
+#define MAX_INTERVAL 60000
+#define STALL_MS 10000
+
+
+/* simulator_alive() returns whether the simulator's process still exists */
+static int simulator_alive(const metrics_segment_t *segment)
+{
+    return kill((pid_t)segment->pid, 0) == 0 || errno != ESRCH;
+}
+
+/*
+ * read_metrics() copies a consistent snapshot of the counters, retrying
+ * while the simulator is in the middle of an update.  It returns -1 if the
+ * simulator exited in the middle of one.
+ */
+static int read_metrics(const metrics_segment_t *segment, metrics_t *m)
+{
+    const uint64_t *from = (const uint64_t*)&segment->metrics;
+    uint64_t *to = (uint64_t*)m, before, after;
+    unsigned int n, retries = 0;
+
+    while (1)
+    {
+        before = __atomic_load_n(&segment->sequence, __ATOMIC_ACQUIRE);
+        if (before & 1)
+        {
+            if (++retries % 1000 == 0 && !simulator_alive(segment))
+                return -1;
+            usleep(10);
+            continue;
+        }
+        for (n=0; n<sizeof(metrics_t) / sizeof(uint64_t); n++)
+            to[n] = __atomic_load_n(&from[n], __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        after = __atomic_load_n(&segment->sequence, __ATOMIC_RELAXED);
+        if (before == after)
+            return 0;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    metrics_segment_t *segment;
+    metrics_t last, now;
+    unsigned int interval = 1000, stalled = 0, n;
+    uint64_t ticks;
+    char *end;
+    long value;
+    int fd;
+
+    if (argc < 2 || argc > 3)
+    {
+        fprintf(stderr, "Usage: ./os-stat <name> [ <interval in ms> ]\n");
+        return -1;
+    }
+    if (argc == 3)
+    {
+        value = strtol(argv[2], &end, 10);
+        if (*argv[2] == '\0' || *end != '\0' || value < 1 ||
+            value > MAX_INTERVAL)
+        {
+            fprintf(stderr, "The interval must be 1 to %d ms\n",
+                    MAX_INTERVAL);
+            return -1;
+        }
+        interval = value;
+    }
+
+    fd = shm_open(argv[1], O_RDONLY, 0);
+    if (fd < 0)
+    {
+        perror(argv[1]);
+        return -1;
+    }
+    segment = mmap(NULL, sizeof(metrics_segment_t), PROT_READ, MAP_SHARED,
+                   fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED ||
+        __atomic_load_n(&segment->magic, __ATOMIC_ACQUIRE) != METRICS_MAGIC)
+    {
+        fprintf(stderr, "%s: not a simulator metrics segment\n", argv[1]);
+        return -1;
+    }
+
+    printf("  Time  Ticks/s  Switch/s   Ru   Re   Wa  Done   I/O  Page  "
+           "CPU busy %%\n");
+    if (read_metrics(segment, &last) < 0)
+    {
+        fprintf(stderr, "%s: the simulator has exited\n", argv[1]);
+        return 1;
+    }
+    while (!last.finished)
+    {
+        usleep(interval * 1000);
+        if (read_metrics(segment, &now) < 0 ||
+            (!now.finished && !simulator_alive(segment)))
+        {
+            fprintf(stderr, "%s: the simulator exited before the end\n",
+                    argv[1]);
+            return 1;
+        }
+
+        /* A simulator that is stopped or hung publishes nothing */
+        if (!now.finished && now.simulator_time == last.simulator_time)
+            stalled += interval;
+        else
+            stalled = 0;
+        if (stalled >= STALL_MS)
+        {
+            fprintf(stderr, "%s: no update for %d s\n", argv[1],
+                    STALL_MS / 1000);
+            return 1;
+        }
+
+        ticks = now.simulator_time - last.simulator_time;
+        printf("%6.1f %8llu %9.1f %4llu %4llu %4llu %5llu %5llu %5llu ",
+            now.simulator_time / 10.0,
+            (unsigned long long)now.ticks_per_second,
+            (now.context_switches - last.context_switches) * 1000.0 / interval,
+            (unsigned long long)now.running, (unsigned long long)now.ready,
+            (unsigned long long)now.waiting,
+            (unsigned long long)now.terminated,
+            (unsigned long long)now.io_queue,
+            (unsigned long long)now.paging_queue);
+        for (n=0; n<now.cpu_count && n<METRICS_MAX_CPUS; n++)
+            printf(" %3.0f", ticks ?
+                100.0 * (now.cpu_busy[n] - last.cpu_busy[n]) / ticks : 0.0);
+        printf("\n");
+        fflush(stdout);
+        last = now;
+    }
+    return 0;
+}
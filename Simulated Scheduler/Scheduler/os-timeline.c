@@ -0,0 +1,679 @@
+/*
+ * os-timeline.c
+ * Multithreaded OS Simulation - timeline reader
+ *
+ * Computes aggregates over a timeline recorded with "-T <file>":
+ *
+ *   ./os-timeline <file>                 the whole run: CPU utilization,
+ *                                        state counts, I/O queues and the
+ *                                        CPU time of each process
+ *   ./os-timeline <file> -w <ticks>      the same per window of <ticks>
+ *   ./os-timeline <file> -p <pid|name>   when and where a process ran
+ *
+ * The file is mapped and decoded a run at a time, reading only the columns
+ * needed; no tick is expanded, so the time taken grows with the number of
+ * runs, not ticks.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "timeline.h"
+
+
+typedef struct {
+    const uint8_t *p, *end;
+    uint32_t value;
+} column_reader_t;
+
+/*
+ * A block: column n is at data + offset[n], and offset[n + 1] - offset[n]
+ * bytes long.  Fields are copied out of the file, as the process names
+ * leave them unaligned.
+ */
+typedef struct {
+    timeline_block_t header;
+    const uint8_t *data;
+    uint64_t *offset;
+} block_t;
+
+/* A run of a process on a CPU, from start to end (excluded) */
+typedef struct {
+    uint32_t start, end, cpu;
+} interval_t;
+
+static const uint8_t *file_start, *file_end;
+static const timeline_header_t *header;
+static const char *names[256];
+static uint8_t name_lengths[256];
+static const uint8_t *first_block;
+
+
+static void corrupt(const char *what)
+{
+    fprintf(stderr, "The timeline is corrupt: %s\n", what);
+    exit(-1);
+}
+
+/*
+ * read_varint() decodes the varint at *p and advances *p past it.  Most
+ * values fit in a byte.  Away from the end of the column, where no varint
+ * can overrun it, it skips the bounds check on each byte.
+ */
+static uint64_t read_varint(const uint8_t **p, const uint8_t *end)
+{
+    uint64_t value = 0;
+    unsigned int shift = 0;
+    uint8_t byte;
+
+    if (*p < end && **p < 0x80)
+        return *(*p)++;
+    if (end - *p >= 10)
+    {
+        do
+        {
+            byte = *(*p)++;
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            shift += 7;
+        } while ((byte & 0x80) && shift < 70);
+        if (byte & 0x80)
+            corrupt("bad varint");
+        return value;
+    }
+
+    do
+    {
+        if (*p >= end || shift > 63)
+            corrupt("truncated varint");
+        byte = *(*p)++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+/*
+ * column_start() starts reading column n of a block; column_next() returns
+ * the length of its next run and stores its value, or returns 0 at the end.
+ */
+static void column_start(column_reader_t *r, const block_t *b, unsigned int n)
+{
+    r->p = b->data + b->offset[n];
+    r->end = b->data + b->offset[n + 1];
+    r->value = 0;
+}
+
+static uint32_t column_next(column_reader_t *r, uint32_t *value)
+{
+    uint64_t delta;
+
+    if (r->p >= r->end)
+        return 0;
+    delta = read_varint(&r->p, r->end);
+    r->value += (uint32_t)((delta >> 1) ^ -(delta & 1));
+    *value = r->value;
+    return (uint32_t)read_varint(&r->p, r->end);
+}
+
+/*
+ * next_block() reads the block at *p into b and advances *p past it, or
+ * returns 0 at the end of the file.
+ */
+static int next_block(const uint8_t **p, block_t *b)
+{
+    uint32_t size;
+    unsigned int n;
+
+    if (*p == file_end)
+        return 0;
+    if ((size_t)(file_end - *p) < sizeof(timeline_block_t) +
+        header->column_count * sizeof(uint32_t))
+        corrupt("truncated block");
+    memcpy(&b->header, *p, sizeof(timeline_block_t));
+    *p += sizeof(timeline_block_t);
+    b->offset[0] = 0;
+    for (n=0; n<header->column_count; n++)
+    {
+        memcpy(&size, *p, sizeof(size));
+        *p += sizeof(size);
+        b->offset[n + 1] = b->offset[n] + size;
+    }
+    b->data = *p;
+    if ((uint64_t)(file_end - b->data) < b->offset[header->column_count])
+        corrupt("truncated block");
+    *p = b->data + b->offset[header->column_count];
+    return 1;
+}
+
+static void start_blocks(const uint8_t **p, block_t *b)
+{
+    static uint64_t *offset = NULL;
+
+    if (offset == NULL)
+    {
+        offset = malloc((header->column_count + 1) * sizeof(uint64_t));
+        if (offset == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(-1);
+        }
+    }
+    *p = first_block;
+    b->offset = offset;
+}
+
+static void map_timeline(const char *path)
+{
+    const uint8_t *p;
+    struct stat st;
+    unsigned int n;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(path);
+        exit(-1);
+    }
+    if ((size_t)st.st_size < sizeof(timeline_header_t))
+        corrupt("no header");
+    file_start = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (file_start == MAP_FAILED)
+    {
+        perror(path);
+        exit(-1);
+    }
+    madvise((void*)file_start, st.st_size, MADV_SEQUENTIAL);
+    file_end = file_start + st.st_size;
+
+    header = (const timeline_header_t*)file_start;
+    if (memcmp(header->magic, TIMELINE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TIMELINE_VERSION)
+    {
+        fprintf(stderr, "%s: not a timeline of this simulator\n", path);
+        exit(-1);
+    }
+    if (header->process_count > 256 ||
+        header->column_count != header->cpu_count + TIMELINE_COUNTS)
+        corrupt("bad header");
+
+    p = file_start + sizeof(timeline_header_t);
+    for (n=0; n<header->process_count; n++)
+    {
+        if (p >= file_end || file_end - p - 1 < *p)
+            corrupt("truncated names");
+        name_lengths[n] = *p;
+        names[n] = (const char*)p + 1;
+        p += 1 + *p;
+    }
+    first_block = p;
+}
+
+/*
+ * find_process() returns the pid of the process named or numbered arg, or
+ * -1 if there is none.
+ */
+static int find_process(const char *arg)
+{
+    char *end;
+    long pid;
+    unsigned int n;
+
+    for (n=0; n<header->process_count; n++)
+        if (strlen(arg) == name_lengths[n] &&
+            memcmp(arg, names[n], name_lengths[n]) == 0)
+            return n;
+    pid = strtol(arg, &end, 10);
+    if (*arg != '\0' && *end == '\0' && pid >= 0 &&
+        pid < header->process_count)
+        return pid;
+    return -1;
+}
+
+/*
+ * summary() prints the aggregates of the whole timeline.  A process's runs
+ * are the intervals it spent on a CPU without a break, joined across blocks;
+ * a process dispatched again on the CPU it just left counts once.
+ */
+static void summary(void)
+{
+    uint64_t busy[header->cpu_count], sum[TIMELINE_COUNTS];
+    uint64_t cpu_ticks[header->process_count], runs[header->process_count];
+    uint32_t max[TIMELINE_COUNTS], last_value[header->cpu_count];
+    uint32_t first = 0, last = 0, length, value, end;
+    uint64_t ticks = 0, blocks = 0;
+    const uint8_t *p;
+    column_reader_t r;
+    unsigned int n;
+    block_t b;
+    static const char *count_names[TIMELINE_COUNTS] = {
+        "Running", "READY", "Waiting", "I/O queue", "Paging queue"
+    };
+
+    memset(busy, 0, sizeof(busy));
+    memset(sum, 0, sizeof(sum));
+    memset(max, 0, sizeof(max));
+    memset(cpu_ticks, 0, sizeof(cpu_ticks));
+    memset(runs, 0, sizeof(runs));
+    memset(last_value, 0, sizeof(last_value));
+
+    start_blocks(&p, &b);
+    while (next_block(&p, &b))
+    {
+        if (blocks == 0)
+            first = b.header.first_tick;
+        else if (b.header.first_tick != last)
+            memset(last_value, 0, sizeof(last_value));
+        last = b.header.first_tick + b.header.tick_count;
+        ticks += b.header.tick_count;
+        blocks++;
+
+        for (n=0; n<header->cpu_count; n++)
+        {
+            column_start(&r, &b, n);
+            end = b.header.first_tick;
+            while ((length = column_next(&r, &value)) > 0)
+            {
+                if (value > header->process_count)
+                    corrupt("bad pid");
+                if (value != 0)
+                {
+                    busy[n] += length;
+                    cpu_ticks[value - 1] += length;
+                    if (end != b.header.first_tick || value != last_value[n])
+                        runs[value - 1]++;
+                }
+                end += length;
+            }
+            last_value[n] = r.value;
+        }
+        for (n=0; n<TIMELINE_COUNTS; n++)
+        {
+            column_start(&r, &b, header->cpu_count + n);
+            while ((length = column_next(&r, &value)) > 0)
+            {
+                sum[n] += (uint64_t)value * length;
+                if (value > max[n])
+                    max[n] = value;
+            }
+        }
+    }
+
+    if (ticks == 0)
+    {
+        printf("The timeline is empty\n");
+        return;
+    }
+    printf("Ticks: %llu, from %.1f s to %.1f s, in %llu blocks\n",
+        (unsigned long long)ticks, first / 10.0, last / 10.0,
+        (unsigned long long)blocks);
+    printf("\nCPU utilization:");
+    for (n=0; n<header->cpu_count; n++)
+        printf(" %.1f%%", 100.0 * busy[n] / ticks);
+    printf("\n\n%-14s %8s %6s\n", "", "Average", "Max");
+    for (n=0; n<TIMELINE_COUNTS; n++)
+        printf("%-14s %8.2f %6u\n", count_names[n], (double)sum[n] / ticks,
+            max[n]);
+    printf("\n%-8s %10s %8s %6s\n", "Process", "CPU time", "Share", "Runs");
+    for (n=0; n<header->process_count; n++)
+        printf("%-8.*s %8.1f s %7.1f%% %6llu\n", name_lengths[n], names[n],
+            cpu_ticks[n] / 10.0, 100.0 * cpu_ticks[n] / ticks,
+            (unsigned long long)runs[n]);
+}
+
+/*
+ * add_run() adds value for each tick of a run to the windows it spans, in
+ * column column of the sums table.
+ */
+static void add_run(uint64_t *sums, unsigned int stride, unsigned int column,
+                    uint32_t first, uint32_t window, uint32_t start,
+                    uint32_t length, uint32_t value)
+{
+    uint32_t index, take;
+
+    while (length > 0)
+    {
+        index = (start - first) / window;
+        take = first + (index + 1) * window - start;
+        if (take > length)
+            take = length;
+        sums[(size_t)index * stride + column] += (uint64_t)value * take;
+        start += take;
+        length -= take;
+    }
+}
+
+/*
+ * windows() prints the CPU utilization, the average number of READY
+ * processes and the average I/O queue length per window of ticks.  The
+ * ticks of a window that were not recorded are left out of its averages.
+ */
+static void windows(uint32_t window)
+{
+    unsigned int stride = header->cpu_count + 3, n;
+    uint32_t first = 0, last = 0, length, value, start, count, w;
+    const uint8_t *p;
+    column_reader_t r;
+    uint64_t *sums, recorded;
+    block_t b;
+    int any = 0;
+
+    /* Size the table from the block headers */
+    start_blocks(&p, &b);
+    while (next_block(&p, &b))
+    {
+        if (!any || b.header.first_tick < first)
+            first = b.header.first_tick;
+        if (!any || b.header.first_tick + b.header.tick_count > last)
+            last = b.header.first_tick + b.header.tick_count;
+        any = 1;
+    }
+    if (!any)
+    {
+        printf("The timeline is empty\n");
+        return;
+    }
+    count = (last - first + window - 1) / window;
+    sums = calloc((size_t)count * stride, sizeof(uint64_t));
+    if (sums == NULL)
+    {
+        fprintf(stderr, "Too many windows\n");
+        exit(-1);
+    }
+
+    /* Columns: the CPUs, the ticks recorded, READY and the I/O queue */
+    start_blocks(&p, &b);
+    while (next_block(&p, &b))
+    {
+        for (n=0; n<header->cpu_count; n++)
+        {
+            column_start(&r, &b, n);
+            start = b.header.first_tick;
+            while ((length = column_next(&r, &value)) > 0)
+            {
+                add_run(sums, stride, n, first, window, start, length,
+                    value != 0);
+                start += length;
+            }
+        }
+        add_run(sums, stride, header->cpu_count, first, window,
+            b.header.first_tick, b.header.tick_count, 1);
+
+        column_start(&r, &b, header->cpu_count + TIMELINE_READY);
+        start = b.header.first_tick;
+        while ((length = column_next(&r, &value)) > 0)
+        {
+            add_run(sums, stride, header->cpu_count + 1, first, window, start,
+                length, value);
+            start += length;
+        }
+        column_start(&r, &b, header->cpu_count + TIMELINE_IO_QUEUE);
+        start = b.header.first_tick;
+        while ((length = column_next(&r, &value)) > 0)
+        {
+            add_run(sums, stride, header->cpu_count + 2, first, window, start,
+                length, value);
+            start += length;
+        }
+    }
+
+    printf("  Time ");
+    for (n=0; n<header->cpu_count; n++)
+        printf("  CPU%2u", n);
+    printf("    All  READY   I/O\n");
+    for (w=0; w<count; w++)
+    {
+        const uint64_t *row = sums + (size_t)w * stride;
+        uint64_t busy = 0;
+
+        recorded = row[header->cpu_count];
+        if (recorded == 0)
+            continue;
+        printf("%6.1f ", (first + (uint64_t)w * window) / 10.0);
+        for (n=0; n<header->cpu_count; n++)
+        {
+            printf(" %5.1f%%", 100.0 * row[n] / recorded);
+            busy += row[n];
+        }
+        printf(" %5.1f%% %6.2f %5.2f\n",
+            100.0 * busy / (recorded * header->cpu_count),
+            (double)row[header->cpu_count + 1] / recorded,
+            (double)row[header->cpu_count + 2] / recorded);
+    }
+    free(sums);
+}
+
+static int compare_intervals(const void *a, const void *b)
+{
+    const interval_t *x = a, *y = b;
+
+    if (x->start != y->start)
+        return x->start < y->start ? -1 : 1;
+    return x->cpu < y->cpu ? -1 : x->cpu > y->cpu;
+}
+
+static int interval_before(const interval_t *x, const interval_t *y)
+{
+    return x->start < y->start || (x->start == y->start && x->cpu < y->cpu);
+}
+
+/*
+ * merge_block() sorts the intervals that started in a block, in which those
+ * of CPU n are intervals[next[n]] up to intervals[end[n]], excluded, in
+ * order.  They are merged into merged through a heap of the CPUs, ordered by
+ * their next interval, and copied back from first on; the open interval of
+ * a CPU follows its interval.
+ */
+static void merge_block(interval_t *intervals, size_t first, size_t *next,
+                        const size_t *end, size_t *open, interval_t *merged)
+{
+    unsigned int heap[header->cpu_count], size = 0, n, i, child, cpu;
+    size_t out = 0;
+
+    for (n=0; n<header->cpu_count; n++)
+        if (next[n] < end[n])
+            heap[size++] = n;
+    for (n=size/2; n-- > 0; )
+    {
+        /* Sift down every node, from the last parent up */
+        for (i=n; (child = 2 * i + 1) < size; i = child)
+        {
+            if (child + 1 < size && interval_before(
+                    &intervals[next[heap[child + 1]]],
+                    &intervals[next[heap[child]]]))
+                child++;
+            if (!interval_before(&intervals[next[heap[child]]],
+                                 &intervals[next[heap[i]]]))
+                break;
+            cpu = heap[i];
+            heap[i] = heap[child];
+            heap[child] = cpu;
+        }
+    }
+
+    while (size > 0)
+    {
+        cpu = heap[0];
+        if (open[cpu] == next[cpu])
+            open[cpu] = first + out;
+        merged[out++] = intervals[next[cpu]++];
+        if (next[cpu] == end[cpu])
+            heap[0] = heap[--size];
+        for (i=0; (child = 2 * i + 1) < size; i = child)
+        {
+            if (child + 1 < size && interval_before(
+                    &intervals[next[heap[child + 1]]],
+                    &intervals[next[heap[child]]]))
+                child++;
+            if (!interval_before(&intervals[next[heap[child]]],
+                                 &intervals[next[heap[i]]]))
+                break;
+            cpu = heap[i];
+            heap[i] = heap[child];
+            heap[child] = cpu;
+        }
+    }
+    memcpy(intervals + first, merged, out * sizeof(interval_t));
+}
+
+/* put_number() writes value right-aligned in width characters at p */
+static char *put_number(char *p, uint32_t value, unsigned int width)
+{
+    char digits[10];
+    unsigned int n = 0;
+
+    do
+    {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (width-- > n)
+        *p++ = ' ';
+    while (n > 0)
+        *p++ = digits[--n];
+    return p;
+}
+
+/*
+ * process_timeline() prints the intervals in which process pid ran, joined
+ * across blocks, with the CPU it ran on.  A block's intervals start after
+ * the ones of the blocks before it, so they are sorted a block at a time,
+ * unless the blocks are out of order.  There may be millions of them, so
+ * they are formatted by hand.
+ */
+static void process_timeline(unsigned int pid)
+{
+    size_t count = 0, capacity = 0, n, open[header->cpu_count];
+    size_t next[header->cpu_count], end[header->cpu_count], first;
+    uint32_t length, value, start, last = 0;
+    const uint8_t *p;
+    interval_t *intervals = NULL, *merged = NULL;
+    uint64_t total = 0;
+    column_reader_t r;
+    unsigned int cpu;
+    char line[64], *l;
+    int ordered = 1;
+    block_t b;
+
+    for (cpu=0; cpu<header->cpu_count; cpu++)
+        open[cpu] = (size_t)-1;
+
+    start_blocks(&p, &b);
+    while (next_block(&p, &b))
+    {
+        if (b.header.first_tick < last)
+            ordered = 0;
+        last = b.header.first_tick + b.header.tick_count;
+        first = count;
+        for (cpu=0; cpu<header->cpu_count; cpu++)
+        {
+            column_start(&r, &b, cpu);
+            start = b.header.first_tick;
+            next[cpu] = count;
+            while ((length = column_next(&r, &value)) > 0)
+            {
+                if (value == pid + 1)
+                {
+                    if (open[cpu] != (size_t)-1 &&
+                        intervals[open[cpu]].end == start)
+                    {
+                        intervals[open[cpu]].end += length;
+                    }
+                    else
+                    {
+                        if (count == capacity)
+                        {
+                            capacity = capacity ? capacity * 2 : 1024;
+                            intervals = realloc(intervals,
+                                capacity * sizeof(interval_t));
+                            merged = realloc(merged,
+                                capacity * sizeof(interval_t));
+                            if (intervals == NULL || merged == NULL)
+                            {
+                                fprintf(stderr, "Out of memory\n");
+                                exit(-1);
+                            }
+                        }
+                        intervals[count].start = start;
+                        intervals[count].end = start + length;
+                        intervals[count].cpu = cpu;
+                        open[cpu] = count++;
+                    }
+                }
+                start += length;
+            }
+            end[cpu] = count;
+        }
+        if (ordered && count - first > 1)
+            merge_block(intervals, first, next, end, open, merged);
+    }
+    if (!ordered)
+        qsort(intervals, count, sizeof(interval_t), compare_intervals);
+
+    printf("Process %.*s (pid %u)\n\n", name_lengths[pid], names[pid], pid);
+    printf("  From      To  CPU\n");
+    for (n=0; n<count; n++)
+    {
+        /* "%4u.%u  %4u.%u  %3u\n" */
+        l = put_number(line, intervals[n].start / 10, 4);
+        *l++ = '.';
+        *l++ = '0' + intervals[n].start % 10;
+        *l++ = ' ';
+        *l++ = ' ';
+        l = put_number(l, intervals[n].end / 10, 4);
+        *l++ = '.';
+        *l++ = '0' + intervals[n].end % 10;
+        *l++ = ' ';
+        *l++ = ' ';
+        l = put_number(l, intervals[n].cpu, 3);
+        *l++ = '\n';
+        fwrite(line, 1, l - line, stdout);
+        total += intervals[n].end - intervals[n].start;
+    }
+    printf("\n%zu runs, %.1f s on a CPU\n", count, total / 10.0);
+    free(intervals);
+    free(merged);
+}
+
+int main(int argc, char *argv[])
+{
+    int pid;
+
+    if (argc != 2 && !(argc == 4 && (strcmp(argv[2], "-w") == 0 ||
+                                     strcmp(argv[2], "-p") == 0)))
+    {
+        fprintf(stderr, "Usage: ./os-timeline <file> [ -w <ticks> | "
+                "-p <pid|name> ]\n");
+        return -1;
+    }
+    map_timeline(argv[1]);
+
+    if (argc == 2)
+        summary();
+    else if (strcmp(argv[2], "-w") == 0)
+    {
+        if (atoi(argv[3]) < 1)
+        {
+            fprintf(stderr, "The window must be at least a tick\n");
+            return -1;
+        }
+        windows(atoi(argv[3]));
+    }
+    else
+    {
+        pid = find_process(argv[3]);
+        if (pid < 0)
+        {
+            fprintf(stderr, "%s: no such process\n", argv[3]);
+            return -1;
+        }
+        process_timeline(pid);
+    }
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * overhead.c
+ * Multithreaded OS Simulation - scheduling overhead model
+ *
+ * See overhead.h.  Only the supervisor thread and context_switch() charge
+ * costs, both with the simulator_mutex held.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "checkpoint.h"
+#include "overhead.h"
+
+
+enum {
+    COST_SWITCH = 0,
+    COST_MIGRATE,
+    COST_DECIDE,
+    COST_PER_READY,
+    COST_COUNT
+};
+
+/* The costs, in 1/OVERHEAD_UNITS ticks */
+static unsigned int cost[COST_COUNT];
+
+/*
+ * The number of switches, migrations and decisions charged, the cost of
+ * each kind, and the whole ticks lost
+ */
+static unsigned int charged[COST_PER_READY];
+static unsigned long long charged_cost[COST_PER_READY];
+static unsigned long long lost_ticks;
+
+
+extern int overhead_init(const char *spec)
+{
+    const char *p = spec;
+    char *end;
+    double value;
+    unsigned int n;
+
+    for (n=0; n<COST_COUNT; n++)
+        cost[n] = 0;
+    if (spec == NULL)
+        return 0;
+
+    for (n=0; n<COST_COUNT; n++)
+    {
+        value = strtod(p, &end);
+        if (end == p || value < 0 || value > 1000)
+            return -1;
+        cost[n] = (unsigned int)(value * OVERHEAD_UNITS + 0.5);
+        p = end;
+        if (*p == '\0')
+            return n >= COST_DECIDE ? 0 : -1;
+        if (*p++ != ',')
+            return -1;
+    }
+    return -1;
+}
+
+extern int overhead_enabled(void)
+{
+    unsigned int n;
+
+    for (n=0; n<COST_COUNT; n++)
+        if (cost[n] != 0)
+            return 1;
+    return 0;
+}
+
+extern unsigned int overhead_charge(unsigned int *carry, int switched,
+                                    int migrated, unsigned int ready)
+{
+    unsigned int total, decide, ticks;
+
+    decide = cost[COST_DECIDE] + ready * cost[COST_PER_READY];
+    total = decide;
+    charged[COST_DECIDE]++;
+    charged_cost[COST_DECIDE] += decide;
+    if (switched)
+    {
+        total += cost[COST_SWITCH];
+        charged[COST_SWITCH]++;
+        charged_cost[COST_SWITCH] += cost[COST_SWITCH];
+    }
+    if (migrated)
+    {
+        total += cost[COST_MIGRATE];
+        charged[COST_MIGRATE]++;
+        charged_cost[COST_MIGRATE] += cost[COST_MIGRATE];
+    }
+
+    *carry += total;
+    ticks = *carry / OVERHEAD_UNITS;
+    *carry %= OVERHEAD_UNITS;
+    lost_ticks += ticks;
+    return ticks;
+}
+
+extern void overhead_print_stats(unsigned int busy_ticks,
+                                 unsigned int total_ticks)
+{
+    if (!overhead_enabled())
+        return;
+
+    printf("Scheduling overhead: %.1f s lost, %.1f%% of busy CPU time "
+        "(%.1f%% of all CPU time)\n", lost_ticks / 10.0,
+        busy_ticks ? 100.0 * lost_ticks / busy_ticks : 0.0,
+        total_ticks ? 100.0 * lost_ticks / total_ticks : 0.0);
+    printf("  %u switches %.1f s, %u migrations %.1f s, "
+        "%u decisions %.1f s\n",
+        charged[COST_SWITCH],
+        charged_cost[COST_SWITCH] / (10.0 * OVERHEAD_UNITS),
+        charged[COST_MIGRATE],
+        charged_cost[COST_MIGRATE] / (10.0 * OVERHEAD_UNITS),
+        charged[COST_DECIDE],
+        charged_cost[COST_DECIDE] / (10.0 * OVERHEAD_UNITS));
+}
+
+extern void overhead_save(void)
+{
+    CHECKPOINT_PUT(charged);
+    CHECKPOINT_PUT(charged_cost);
+    CHECKPOINT_PUT(lost_ticks);
+}
+
+extern void overhead_restore(void)
+{
+    CHECKPOINT_GET(charged);
+    CHECKPOINT_GET(charged_cost);
+    CHECKPOINT_GET(lost_ticks);
+}
@@ -0,0 +1,60 @@
+/*
+ * overhead.h
+ * Multithreaded OS Simulation - scheduling overhead model
+ *
+ * By default context_switch() costs no simulated time.  With an overhead
+ * model, every dispatch of a process costs its CPU the time the OS would
+ * spend on it, during which the process holds the CPU without making
+ * progress.  The model is selected with a spec string of costs in ticks:
+ *
+ *   <switch>,<migrate>,<decide>[,<per ready>]
+ *
+ *   switch    : loading a process other than the one the CPU ran last
+ *   migrate   : on top of a switch, for a process that last ran on another
+ *               CPU, whose cache is cold there
+ *   decide    : the scheduler's decision
+ *   per ready : added to the decision for each process left READY, as a
+ *               longer run queue takes longer to pick from (default 0)
+ *
+ * Costs are kept in 1/OVERHEAD_UNITS ticks.  Each CPU carries the part of a
+ * tick it owes over to its next dispatch, so that costs far below a tick
+ * are charged as a whole tick every so often.  A decision that leaves the
+ * CPU idle is free, as the CPU has nothing else to do.
+ */
+
+#ifndef __OVERHEAD_H__
+#define __OVERHEAD_H__
+
+
+#define OVERHEAD_UNITS 1000
+
+
+/*
+ * overhead_init() selects the costs in spec (NULL for none), and returns 0,
+ *   or -1 if spec is not valid.
+ *
+ * overhead_enabled() returns 1 if a dispatch costs anything.
+ *
+ * overhead_charge() returns the whole ticks a CPU loses to a dispatch,
+ *   carrying the rest over in *carry.  switched and migrated tell whether
+ *   the dispatch is a switch and a migration, and ready is the number of
+ *   processes left READY.
+ *
+ * overhead_print_stats() prints the time lost, as a share of busy_ticks,
+ *   the ticks processes spent running, and of total_ticks, the ticks of all
+ *   CPUs.
+ *
+ * overhead_save() and overhead_restore() write the totals to the open
+ *   checkpoint, and read them back.
+ */
+extern int overhead_init(const char *spec);
+extern int overhead_enabled(void);
+extern unsigned int overhead_charge(unsigned int *carry, int switched,
+                                    int migrated, unsigned int ready);
+extern void overhead_print_stats(unsigned int busy_ticks,
+                                 unsigned int total_ticks);
+extern void overhead_save(void);
+extern void overhead_restore(void);
+
+
+#endif /* __OVERHEAD_H__ */
@@ -0,0 +1,180 @@
+/*
+ * policy-classify.c
+ * Multithreaded OS Simulation - behavior-classifying Round-Robin policy
+ *
+ * Round-Robin that tells interactive processes from batch ones by what they
+ * do on the CPU, not by their names or priorities.  For each process it
+ * keeps moving averages (weight 1/4) of the length of its CPU bursts, from
+ * a wake-up to the next yield however many time slices that takes, and of
+ * the share of the times it left the CPU by yielding rather than being
+ * preempted.  A process which mostly yields, and whose bursts average no
+ * more than INTERACTIVE_SLICES time slices, is interactive; any other is
+ * batch.  (A burst also holds the CPU in the tick in which it yields, so a
+ * burst that just fits in a slice measures a tick longer.)  A process is
+ * unclassified until it has left the CPU CLASSIFY_MIN_EVENTS times.
+ *
+ * An interactive process that wakes up is boosted: it goes ahead of the
+ * processes that are not, and preempts a CPU running one of them if no CPU
+ * is idle.  A batch process gets BATCH_SLICE_FACTOR time slices at a time,
+ * so it is preempted less often once it is known not to need the CPU
+ * promptly.
+ *
+ * The workload's names give away its intent ("I..." interactive, "C..."
+ * CPU-bound), which the policy never looks at except to report how often
+ * its classification agreed.  See policy.h.
+ */
+
+#include <stdio.h>
+
+#include "policy.h"
+#include "process.h"
+
+
+#define CLASSIFY_MIN_EVENTS 3
+#define INTERACTIVE_SLICES 2
+#define BATCH_SLICE_FACTOR 4
+
+typedef enum {
+    CLASS_UNKNOWN = 0,
+    CLASS_INTERACTIVE,
+    CLASS_BATCH
+} process_class_t;
+
+static const char *class_names[] = { "unknown", "interactive", "batch" };
+
+/*
+ * Boosted READY processes, then the others, each a FIFO
+ */
+static pcb_t *boost_head = NULL, *boost_tail = NULL;
+static pcb_t *ready_head = NULL, *ready_tail = NULL;
+static int time_slice;
+
+/*
+ *   class       : the process's class
+ *   events      : the times it left the CPU
+ *   burst       : the ticks run in the burst in progress
+ *   burst_avg   : the average burst, in 1/8 ticks
+ *   yield_share : the share of yields among the times it left the CPU, in
+ *                 1/256ths
+ */
+static process_class_t class[PROCESS_COUNT];
+static unsigned int events[PROCESS_COUNT];
+static unsigned int burst[PROCESS_COUNT];
+static unsigned int burst_avg[PROCESS_COUNT];
+static unsigned int yield_share[PROCESS_COUNT];
+
+/* Dispatches by class, and those classified as the name says */
+static unsigned int dispatches[3];
+static unsigned int agreed;
+
+
+static int classify_init(const policy_config_t *config)
+{
+    time_slice = config->time_slice;
+    return time_slice >= 1 ? 0 : -1;
+}
+
+static void append(pcb_t **head, pcb_t **tail, pcb_t *process)
+{
+    process->next = NULL;
+    if (*tail == NULL)
+        *head = process;
+    else
+        (*tail)->next = process;
+    *tail = process;
+}
+
+static void classify_enqueue(pcb_t *process, int woken, unsigned int now)
+{
+    if (woken && class[process->pid] == CLASS_INTERACTIVE)
+        append(&boost_head, &boost_tail, process);
+    else
+        append(&ready_head, &ready_tail, process);
+}
+
+static pcb_t* classify_dequeue(unsigned int cpu_id, unsigned int now,
+                               int *slice)
+{
+    pcb_t **head = boost_head != NULL ? &boost_head : &ready_head;
+    pcb_t **tail = boost_head != NULL ? &boost_tail : &ready_tail;
+    pcb_t *process = *head;
+    process_class_t c;
+
+    if (process == NULL)
+        return NULL;
+
+    *head = process->next;
+    if (*head == NULL)
+        *tail = NULL;
+    process->next = NULL;
+
+    c = class[process->pid];
+    *slice = c == CLASS_BATCH ? time_slice * BATCH_SLICE_FACTOR : time_slice;
+    dispatches[c]++;
+    if (c != CLASS_UNKNOWN &&
+        (c == CLASS_INTERACTIVE) == (process->name[0] == 'I'))
+        agreed++;
+    return process;
+}
+
+static int classify_priority(pcb_t *process)
+{
+    return class[process->pid] == CLASS_INTERACTIVE;
+}
+
+/*
+ * classify_ran() folds the time a process just spent on a CPU into its
+ * averages, and classifies it again.
+ */
+static void classify_ran(pcb_t *process, unsigned int ticks, int preempted)
+{
+    unsigned int pid = process->pid;
+    unsigned int longest = (unsigned int)time_slice * INTERACTIVE_SLICES << 3;
+
+    burst[pid] += ticks;
+    yield_share[pid] -= yield_share[pid] >> 2;
+    if (!preempted)
+    {
+        yield_share[pid] += 256 >> 2;
+        burst_avg[pid] = burst_avg[pid] == 0 ? burst[pid] << 3 :
+            burst_avg[pid] - (burst_avg[pid] >> 2) + (burst[pid] << 1);
+        burst[pid] = 0;
+    }
+    events[pid]++;
+
+    if (events[pid] < CLASSIFY_MIN_EVENTS)
+        class[pid] = CLASS_UNKNOWN;
+    else if (burst_avg[pid] <= longest && yield_share[pid] >= 128)
+        class[pid] = CLASS_INTERACTIVE;
+    else
+        class[pid] = CLASS_BATCH;
+}
+
+static void classify_print_stats(unsigned int end_time)
+{
+    unsigned int classified = dispatches[CLASS_INTERACTIVE] +
+                              dispatches[CLASS_BATCH];
+    unsigned int n, right = 0;
+
+    printf("\nProcess    Class        Avg burst  Yields\n");
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        printf("%-10s %-12s %7.1f s %6.0f%%\n", processes[n].name,
+            class_names[class[n]], burst_avg[n] / 80.0,
+            yield_share[n] * 100.0 / 256);
+        if (class[n] != CLASS_UNKNOWN &&
+            (class[n] == CLASS_INTERACTIVE) == (processes[n].name[0] == 'I'))
+            right++;
+    }
+    printf("Classification accuracy: %.1f%% of %u dispatches classified "
+        "(%u before), %u of %d processes at the end\n",
+        classified ? 100.0 * agreed / classified : 0.0, classified,
+        dispatches[CLASS_UNKNOWN], right, PROCESS_COUNT);
+}
+
+const sched_policy_t classify_policy = {
+    "classify", classify_init, classify_enqueue, classify_dequeue,
+    classify_priority, NULL, classify_print_stats, classify_ran
+};
+
+POLICY_EXPORT(classify_policy)
@@ -0,0 +1,54 @@
+/*
+ * policy-fifo.c
+ * Multithreaded OS Simulation - FIFO scheduling policy
+ *
+ * READY processes run in the order they became READY: First Come First
+ * Served without a time slice, Round-Robin with one.  See policy.h.
+ */
+
+#include <stddef.h>
+
+#include "policy.h"
+
+
+static pcb_t *head = NULL, *tail = NULL;
+static int time_slice = -1;
+
+
+static int fifo_init(const policy_config_t *config)
+{
+    time_slice = config->time_slice;
+    return 0;
+}
+
+static void fifo_enqueue(pcb_t *process, int woken, unsigned int now)
+{
+    process->next = NULL;
+    if (tail == NULL)
+        head = process;
+    else
+        tail->next = process;
+    tail = process;
+}
+
+static pcb_t* fifo_dequeue(unsigned int cpu_id, unsigned int now,
+                           int *slice)
+{
+    pcb_t *process = head;
+
+    if (process == NULL)
+        return NULL;
+
+    head = process->next;
+    if (head == NULL)
+        tail = NULL;
+    process->next = NULL;
+    *slice = time_slice;
+    return process;
+}
+
+const sched_policy_t fifo_policy = {
+    "fifo", fifo_init, fifo_enqueue, fifo_dequeue, NULL, NULL, NULL
+};
+
+POLICY_EXPORT(fifo_policy)
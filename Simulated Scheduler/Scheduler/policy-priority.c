@@ -0,0 +1,178 @@
+/*
+ * policy-priority.c
+ * Multithreaded OS Simulation - Static Priority scheduling policy
+ *
+ * READY processes are kept in one list per static priority.  A process's
+ * effective priority is its static priority plus one level for every
+ * aging_rate ticks it has waited, up to aging_cap levels.  Aging is computed
+ * when a process is picked, so it costs nothing per tick.
+ *
+ * A preempted process keeps the levels it gained, so that a process that
+ * aged its way onto a CPU is not sent back to the end of the line by the
+ * next high priority wake-up; it starts over when it finishes its burst.
+ * It does so by starting to age that much earlier, and each list is kept in
+ * the order its processes started aging, so the process at the head of a
+ * list has the highest effective priority of its level, and the next
+ * process is found by comparing the heads alone.
+ *
+ * With priority inheritance, a process holding a simulated mutex other
+ * processes wait for is treated as if it had their priority, and moves to
+ * the matching list when that changes.  See policy.h.
+ */
+
+#include <stdio.h>
+
+#include "policy.h"
+#include "process.h"
+
+
+/* static_priority runs from 0 to 10 */
+#define PRIORITY_LEVELS 11
+
+static policy_config_t config;
+static pcb_t *priority_head[PRIORITY_LEVELS];
+
+static int ready_level[PROCESS_COUNT];         /* list a READY process is in,
+                                                  -1 if none */
+static unsigned int ready_since[PROCESS_COUNT]; /* when it became READY */
+static unsigned int aging_start[PROCESS_COUNT]; /* when it started aging */
+static int aging_boost[PROCESS_COUNT];         /* levels gained when last
+                                                  picked */
+static unsigned int max_wait[PROCESS_COUNT];   /* longest time READY */
+
+
+static int priority_init(const policy_config_t *options)
+{
+    unsigned int n;
+
+    config = *options;
+    for (n=0; n<PROCESS_COUNT; n++)
+        ready_level[n] = -1;
+    return 0;
+}
+
+/*
+ * base_priority() returns the priority a process is filed under: its static
+ * priority, or the priority it inherited if that is higher and priority
+ * inheritance is on.
+ */
+static int base_priority(pcb_t *process)
+{
+    unsigned int inherited;
+
+    inherited = __atomic_load_n(&process->inherited_priority, __ATOMIC_RELAXED);
+    if (config.priority_inheritance && inherited > process->static_priority)
+        return inherited;
+    return process->static_priority;
+}
+
+/* insert() files a process after every process that started aging before */
+static void insert(pcb_t *process, int level)
+{
+    pcb_t **link = &priority_head[level];
+
+    while (*link != NULL &&
+           aging_start[(*link)->pid] <= aging_start[process->pid])
+        link = &(*link)->next;
+    process->next = *link;
+    *link = process;
+    ready_level[process->pid] = level;
+}
+
+static void priority_enqueue(pcb_t *process, int woken, unsigned int now)
+{
+    /* A process woken up starts a new burst, and starts aging over */
+    if (woken)
+        aging_boost[process->pid] = 0;
+    ready_since[process->pid] = now;
+    aging_start[process->pid] = now -
+        aging_boost[process->pid] * config.aging_rate;
+    insert(process, base_priority(process));
+}
+
+/*
+ * Ties go to the higher level.  The process picked records how long it
+ * waited.
+ */
+static pcb_t* priority_dequeue(unsigned int cpu_id, unsigned int now,
+                               int *slice)
+{
+    int level, boost, effective, best = -1, best_effective = -1;
+    pcb_t *first;
+
+    for (level = PRIORITY_LEVELS - 1; level >= 0; level--)
+    {
+        if (priority_head[level] == NULL)
+            continue;
+        effective = level;
+        if (config.aging_rate > 0)
+        {
+            boost = (now - aging_start[priority_head[level]->pid]) /
+                    config.aging_rate;
+            effective += boost < config.aging_cap ? boost : config.aging_cap;
+        }
+        if (effective > best_effective)
+        {
+            best = level;
+            best_effective = effective;
+        }
+    }
+    if (best < 0)
+        return NULL;
+
+    first = priority_head[best];
+    priority_head[best] = first->next;
+    first->next = NULL;
+    aging_boost[first->pid] = best_effective - best;
+    ready_level[first->pid] = -1;
+    if (now - ready_since[first->pid] > max_wait[first->pid])
+        max_wait[first->pid] = now - ready_since[first->pid];
+
+    *slice = -1;
+    return first;
+}
+
+/* A running process is compared counting the levels it gained by aging */
+static int priority_of(pcb_t *process)
+{
+    return base_priority(process) + aging_boost[process->pid];
+}
+
+static int priority_moved(pcb_t *process)
+{
+    int level, old;
+    pcb_t **link;
+
+    if (!config.priority_inheritance)
+        return 0;
+
+    level = base_priority(process);
+    old = ready_level[process->pid];
+    if (old < 0 || old == level)
+        return 0;
+
+    /* Unlink the process from its old list, and file it in the new one */
+    link = &priority_head[old];
+    while (*link != process)
+        link = &(*link)->next;
+    *link = process->next;
+    insert(process, level);
+    return 1;
+}
+
+static void priority_print_stats(unsigned int end_time)
+{
+    unsigned int n;
+
+    printf("\nProcess    Priority    Max wait\n");
+    for (n=0; n<PROCESS_COUNT; n++)
+        printf("%-10s %8u %9.1f s\n", processes[n].name,
+            processes[n].static_priority, (float)max_wait[n] / 10.0);
+}
+
+const sched_policy_t priority_policy = {
+    "priority", priority_init, priority_enqueue, priority_dequeue,
+    priority_of, priority_moved, priority_print_stats
+};
+
+POLICY_EXPORT(priority_policy)
@@ -0,0 +1,105 @@
+/*
+ * policy.h
+ * Multithreaded OS Simulation - scheduling policies
+ *
+ * A scheduling policy decides which READY process runs next, for how long,
+ * and whether a process that becomes READY should preempt a running one.
+ * The scheduler in student.c does everything else: it handles the
+ * simulator's events, keeps current[], and sleeps idle CPUs until a process
+ * is READY.  It calls the policy's operations with its ready queue lock
+ * held, so a policy needs no locking of its own.
+ *
+ * The FCFS and Round-Robin schedulers (one FIFO policy, with or without a
+ * time slice), the Static Priority scheduler and the classifying Round-Robin
+ * scheduler are policies built into the simulator.  A policy can also be
+ * built as a shared object and loaded at run time with "-L <file>"; it then
+ * exports its operations as
+ *
+ *   const sched_policy_t *scheduler_policy;
+ *
+ * which POLICY_EXPORT() defines when the file is built with -DPOLICY_PLUGIN.
+ * A plugin may call the simulator functions in os-sim.h, which the
+ * simulator exports for it, but not from its operations: they are passed
+ * the current time instead.
+ */
+
+#ifndef __POLICY_H__
+#define __POLICY_H__
+
+#include "os-sim.h"
+
+
+/*
+ * The options a policy is started with, from the command line.
+ *
+ *   cpu_count  : the number of CPUs
+ *   time_slice : the time slice in ticks (-r), -1 for none
+ *   aging_rate : ticks READY per priority level gained (-A), 0 for none
+ *   aging_cap  : most levels gained by aging (-M)
+ *   priority_inheritance : whether mutex owners inherit the priority of the
+ *        processes waiting for them (-i)
+ */
+typedef struct {
+    unsigned int cpu_count;
+    int time_slice;
+    int aging_rate;
+    int aging_cap;
+    int priority_inheritance;
+} policy_config_t;
+
+
+/*
+ * The operations of a policy.  Only name, init, enqueue and dequeue are
+ * required; the others may be NULL.
+ *
+ *   init : called once before the simulation starts; returns 0, or -1 if
+ *        the options don't suit the policy.
+ *
+ *   enqueue : adds a process that became READY at time now.  woken is 1 if
+ *        it comes back from I/O or a lock, or is new, 0 if it was preempted.
+ *
+ *   dequeue : removes and returns the process to run next on a CPU at time
+ *        now, or NULL if none is READY, and stores its time slice (-1 for
+ *        none).
+ *
+ *   priority : returns the priority a process is compared at, READY or
+ *        running; a process that becomes READY preempts the running process
+ *        of the lowest priority, if that is lower.  NULL never preempts.
+ *
+ *   priority_changed : called when a process's inherited priority changed;
+ *        returns 1 if the process is READY and its priority moved, so that
+ *        it is compared with the running processes again.
+ *
+ *   print_stats : prints the policy's statistics at the end of the run.
+ *
+ *   ran : called when a process leaves a CPU after running for ticks ticks;
+ *        preempted is 1 if its time slice expired or it was preempted, 0 if
+ *        it yielded the CPU or terminated.  It is called before the process
+ *        is enqueued again.
+ */
+typedef struct {
+    const char *name;
+    int (*init)(const policy_config_t *config);
+    void (*enqueue)(pcb_t *process, int woken, unsigned int now);
+    pcb_t* (*dequeue)(unsigned int cpu_id, unsigned int now, int *time_slice);
+    int (*priority)(pcb_t *process);
+    int (*priority_changed)(pcb_t *process);
+    void (*print_stats)(unsigned int end_time);
+    void (*ran)(pcb_t *process, unsigned int ticks, int preempted);
+} sched_policy_t;
+
+
+/* The built-in policies */
+extern const sched_policy_t fifo_policy;
+extern const sched_policy_t priority_policy;
+extern const sched_policy_t classify_policy;
+
+
+#ifdef POLICY_PLUGIN
+#define POLICY_EXPORT(p) const sched_policy_t *scheduler_policy = &(p);
+#else
+#define POLICY_EXPORT(p)
+#endif
+
+
+#endif /* __POLICY_H__ */
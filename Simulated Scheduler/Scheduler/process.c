@@ -6,233 +6,208 @@
  * This file contains process data for the simulator.
  */
 
+#include <stddef.h>
+
 #include "os-sim.h"
 #include "process.h"
+#include "program.h"
 
 
 /*
  * Note: The operations must alternate: OP_CPU, OP_IO, OP_CPU, ...
+ * OP_MEM operations may be put anywhere before an OP_CPU; they are not
+ * counted when alternating.
  * In addition, the first and last operations must be OP_CPU.  Otherwise,
  * the simulator will not work.
+ *
+ * REPEAT(length, count) runs the length operations before it count more
+ * times (see program.h); the alternation must hold across it.
  */
+#define OP(type, time) PROGRAM_OP(OP_##type, time)
+#define REPEAT(length, count) PROGRAM_REPEAT(length, count)
 
-static op_t pid0_ops[] = {
-    { OP_CPU, 2 },
-    { OP_IO, 2 },
-    { OP_CPU, 3 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 2 },
-    { OP_CPU, 3 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 2 },
-    { OP_CPU, 3 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 2 },
-    { OP_CPU, 3 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid0_program[] = {
+    OP(MEM, 6),
+    OP(CPU, 2),
+    OP(IO, 2),
+    OP(ACQUIRE, 0),
+    OP(CPU, 3),
+    OP(RELEASE, 0),
+    OP(IO, 5),
+    OP(CPU, 1),
+    OP(IO, 4),
+    REPEAT(8, 2),
+    OP(CPU, 2),
+    OP(IO, 5),
+    OP(CPU, 1),
+    OP(IO, 4),
+    OP(CPU, 2),
+    OP(IO, 2),
+    OP(ACQUIRE, 0),
+    OP(CPU, 3),
+    OP(RELEASE, 0),
+    OP(IO, 5),
+    OP(CPU, 1),
+    OP(IO, 4),
+    OP(CPU, 2),
+    OP(TERMINATE, 0)
 };
 
-static op_t pid1_ops[] = {
-    { OP_CPU, 3 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 6 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 4 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 6 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 4 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 6 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 4 },
-    { OP_IO, 3 },
-    { OP_CPU, 4 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 6 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 4 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid1_program[] = {
+    OP(MEM, 2),
+    OP(CPU, 3),
+    OP(IO, 4),
+    OP(CPU, 2),
+    OP(IO, 6),
+    OP(CPU, 1),
+    OP(IO, 3),
+    OP(CPU, 4),
+    REPEAT(6, 2),
+    OP(IO, 3),
+    OP(CPU, 4),
+    OP(IO, 4),
+    OP(CPU, 2),
+    OP(IO, 6),
+    OP(CPU, 1),
+    OP(IO, 3),
+    OP(CPU, 4),
+    OP(TERMINATE, 0)
 };
 
-static op_t pid2_ops[] = {
-    { OP_CPU, 1 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 3 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 3 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 3 },
-    { OP_IO, 4 },
-    { OP_CPU, 2 },
-    { OP_IO, 5 },
-    { OP_CPU, 1 },
-    { OP_IO, 3 },
-    { OP_CPU, 3 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid2_program[] = {
+    OP(MEM, 12),
+    OP(CPU, 1),
+    OP(IO, 4),
+    OP(CPU, 2),
+    OP(IO, 5),
+    OP(CPU, 1),
+    OP(IO, 3),
+    OP(CPU, 3),
+    REPEAT(6, 3),
+    OP(TERMINATE, 0)
 };
 
-static op_t pid3_ops[] = {
-    { OP_CPU, 9 },
-    { OP_IO, 1 },
-    { OP_CPU, 6 },
-    { OP_IO, 1 },
-    { OP_CPU, 8 },
-    { OP_IO, 1 },
-    { OP_CPU, 7 },
-    { OP_IO, 1 },
-    { OP_CPU, 6 },
-    { OP_IO, 1 },
-    { OP_CPU, 8 },
-    { OP_IO, 1 },
-    { OP_CPU, 7 },
-    { OP_IO, 1 },
-    { OP_CPU, 6 },
-    { OP_IO, 1 },
-    { OP_CPU, 8 },
-    { OP_IO, 1 },
-    { OP_CPU, 8 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid3_program[] = {
+    OP(MEM, 4),
+    OP(CPU, 9),
+    OP(IO, 1),
+    OP(CPU, 6),
+    OP(IO, 1),
+    OP(CPU, 8),
+    OP(IO, 1),
+    OP(CPU, 7),
+    REPEAT(6, 1),
+    OP(IO, 1),
+    OP(CPU, 6),
+    OP(IO, 1),
+    OP(CPU, 8),
+    REPEAT(2, 1),
+    OP(TERMINATE, 0)
 };
 
-static op_t pid4_ops[] = {
-    { OP_CPU, 10 }, 
-    { OP_IO, 1 },
-    { OP_CPU, 14 },
-    { OP_IO, 1 },
-    { OP_CPU, 7 },
-    { OP_IO, 2 },
-    { OP_CPU, 11 },
-    { OP_IO, 1 },
-    { OP_CPU, 14 },
-    { OP_IO, 1 },
-    { OP_CPU, 7 },
-    { OP_IO, 2 },
-    { OP_CPU, 11 },
-    { OP_IO, 1 },
-    { OP_CPU, 14 },
-    { OP_IO, 1 },
-    { OP_CPU, 7 },
-    { OP_IO, 2 },
-    { OP_CPU, 11 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid4_program[] = {
+    OP(MEM, 16),
+    OP(CPU, 10),
+    OP(IO, 1),
+    OP(ACQUIRE, 1),
+    OP(CPU, 14),
+    OP(RELEASE, 1),
+    OP(IO, 1),
+    OP(CPU, 7),
+    OP(IO, 2),
+    OP(CPU, 11),
+    REPEAT(8, 1),
+    OP(IO, 1),
+    OP(ACQUIRE, 1),
+    OP(CPU, 14),
+    OP(RELEASE, 1),
+    OP(IO, 1),
+    OP(CPU, 7),
+    OP(IO, 2),
+    OP(MEM, 28),
+    OP(CPU, 11),
+    OP(TERMINATE, 0)
 };
 
-static op_t pid5_ops[] = {
-    { OP_CPU, 9 }, 
-    { OP_IO, 1 },
-    { OP_CPU, 10 },
-    { OP_IO, 2 },
-    { OP_CPU, 15 },
-    { OP_IO, 1 },
-    { OP_CPU, 8 },
-    { OP_IO, 1 },
-    { OP_CPU, 10 },
-    { OP_IO, 2 },
-    { OP_CPU, 15 },
-    { OP_IO, 1 },
-    { OP_CPU, 8 },
-    { OP_IO, 1 },
-    { OP_CPU, 10 },
-    { OP_IO, 2 },
-    { OP_CPU, 15 },
-    { OP_IO, 1 },
-    { OP_CPU, 8 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid5_program[] = {
+    OP(MEM, 20),
+    OP(CPU, 9),
+    OP(IO, 1),
+    OP(CPU, 10),
+    OP(IO, 2),
+    OP(ACQUIRE, 1),
+    OP(CPU, 15),
+    OP(RELEASE, 1),
+    OP(IO, 1),
+    OP(CPU, 8),
+    REPEAT(8, 2),
+    OP(TERMINATE, 0)
 };
 
-static op_t pid6_ops[] = {
-    { OP_CPU, 6 }, 
-    { OP_IO, 3 },
-    { OP_CPU, 9 },
-    { OP_IO, 1 },
-    { OP_CPU, 14 },
-    { OP_IO, 1 },
-    { OP_CPU, 11 },
-    { OP_IO, 3 },
-    { OP_CPU, 9 },
-    { OP_IO, 1 },
-    { OP_CPU, 14 },
-    { OP_IO, 1 },
-    { OP_CPU, 11 },
-    { OP_IO, 3 },
-    { OP_CPU, 9 },
-    { OP_IO, 1 },
-    { OP_CPU, 14 },
-    { OP_IO, 1 },
-    { OP_CPU, 11 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid6_program[] = {
+    OP(MEM, 24),
+    OP(CPU, 6),
+    OP(IO, 3),
+    OP(CPU, 9),
+    OP(IO, 1),
+    OP(ACQUIRE, 1),
+    OP(CPU, 14),
+    OP(RELEASE, 1),
+    OP(IO, 1),
+    OP(CPU, 11),
+    REPEAT(8, 2),
+    OP(TERMINATE, 0)
 };
 
-static op_t pid7_ops[] = {
-    { OP_CPU, 6 }, 
-    { OP_IO, 3 },
-    { OP_CPU, 12 },
-    { OP_IO, 3 },
-    { OP_CPU, 7 },
-    { OP_IO, 1 },
-    { OP_CPU, 9 },
-    { OP_IO, 3 },
-    { OP_CPU, 12 },
-    { OP_IO, 3 },
-    { OP_CPU, 7 },
-    { OP_IO, 1 },
-    { OP_CPU, 9 },
-    { OP_IO, 3 },
-    { OP_CPU, 12 },
-    { OP_IO, 3 },
-    { OP_CPU, 7 },
-    { OP_IO, 1 },
-    { OP_CPU, 9 },
-    { OP_TERMINATE, 0 }
+static const program_word_t pid7_program[] = {
+    OP(MEM, 12),
+    OP(CPU, 6),
+    OP(IO, 3),
+    OP(ACQUIRE, 0),
+    OP(CPU, 12),
+    OP(IO, 3),
+    OP(CPU, 7),
+    OP(RELEASE, 0),
+    OP(IO, 1),
+    OP(CPU, 9),
+    REPEAT(8, 2),
+    OP(TERMINATE, 0)
 };
 
-pcb_t processes[PROCESS_COUNT] = {
-    { 0, "Iapache", 8, PROCESS_NEW, pid0_ops },
-    { 1, "Ibash", 7, PROCESS_NEW, pid1_ops },
-    { 2, "Imozilla", 7, PROCESS_NEW, pid2_ops },
-    { 3, "Ccpu", 5, PROCESS_NEW, pid3_ops },
-    { 4, "Cgcc", 1, PROCESS_NEW, pid4_ops },
-    { 5, "Cspice", 2, PROCESS_NEW, pid5_ops },
-    { 6, "Cmysql", 4, PROCESS_NEW, pid6_ops },
-    { 7, "Csim", 3, PROCESS_NEW, pid7_ops }
+/*
+ * Scheduling groups: the interactive processes get twice the share of the
+ * batch ones, and batch work is capped at 60% of one CPU.  Within batch,
+ * the database gets twice the share of the builds but is capped at 30%.
+ */
+cgroup_t cgroups[CGROUP_COUNT] = {
+    { "/", -1, 1024, 0, 0 },
+    { "/interactive", 0, 2048, 0, 0 },
+    { "/batch", 0, 1024, 6, 10 },
+    { "/batch/build", 2, 1024, 0, 0 },
+    { "/batch/db", 2, 2048, 3, 10 }
 };
 
+/*
+ * Simulated locks, taken only with set_lock_workload(): Iapache and Csim
+ * share the database mutex, and Csim holds it across an I/O, so Ccpu can run
+ * ahead of Iapache by keeping Csim off the CPU (priority inversion).  The
+ * builds and the database share two scratch areas.
+ */
+sim_lock_t locks[LOCK_COUNT] = {
+    { "db", 1 },
+    { "scratch", 2 }
+};
 
+/*
+ * Process groups: Cgcc and Cspice form group 1, Cmysql and Csim form group 2.
+ */
+pcb_t processes[PROCESS_COUNT] = {
+    { 0, "Iapache", 8, PROCESS_NEW, pid0_program, NULL, 0, 1 },
+    { 1, "Ibash", 7, PROCESS_NEW, pid1_program, NULL, 0, 1 },
+    { 2, "Imozilla", 7, PROCESS_NEW, pid2_program, NULL, 0, 1 },
+    { 3, "Ccpu", 5, PROCESS_NEW, pid3_program, NULL, 0, 3 },
+    { 4, "Cgcc", 1, PROCESS_NEW, pid4_program, NULL, 1, 3 },
+    { 5, "Cspice", 2, PROCESS_NEW, pid5_program, NULL, 1, 3 },
+    { 6, "Cmysql", 4, PROCESS_NEW, pid6_program, NULL, 2, 4 },
+    { 7, "Csim", 3, PROCESS_NEW, pid7_program, NULL, 2, 4 }
+};
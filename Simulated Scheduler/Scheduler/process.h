@@ -13,6 +13,12 @@
 #define PROCESS_COUNT 8
 extern pcb_t processes[PROCESS_COUNT];
 
+#define CGROUP_COUNT 5
+extern cgroup_t cgroups[CGROUP_COUNT];
+
+#define LOCK_COUNT 2
+extern sim_lock_t locks[LOCK_COUNT];
+
 
 
 
@@ -0,0 +1,54 @@
+/*
+ * program.c
+ * Multithreaded OS Simulation - packed process programs
+ *
+ * See program.h.
+ */
+
+#include "program.h"
+
+
+extern void program_reset(pcb_t *pcb)
+{
+    pcb->pc.index = 0;
+    pcb->pc.pass = 0;
+    pcb->pc.time = PROGRAM_TIME(pcb->program[0]);
+}
+
+extern op_type program_op(const pcb_t *pcb)
+{
+    return PROGRAM_TYPE(pcb->program[pcb->pc.index]);
+}
+
+extern void program_next(pcb_t *pcb)
+{
+    program_word_t word;
+
+    word = pcb->program[++pcb->pc.index];
+    if (PROGRAM_TYPE(word) == OP_REPEAT)
+    {
+        if (pcb->pc.pass < PROGRAM_TIME(word) >> PROGRAM_LENGTH_BITS)
+        {
+            /* Back to the start of the run for another pass */
+            pcb->pc.pass++;
+            pcb->pc.index -= PROGRAM_TIME(word) & PROGRAM_LENGTH_MAX;
+        }
+        else
+        {
+            pcb->pc.pass = 0;
+            pcb->pc.index++;
+        }
+    }
+    pcb->pc.time = PROGRAM_TIME(pcb->program[pcb->pc.index]);
+}
+
+extern int program_valid(const pcb_t *pcb)
+{
+    unsigned int n;
+
+    for (n=0; n<pcb->pc.index; n++)
+        if (PROGRAM_TYPE(pcb->program[n]) == OP_TERMINATE)
+            return 0;
+    return PROGRAM_TYPE(pcb->program[n]) != OP_REPEAT &&
+           pcb->pc.time >= 0 && pcb->pc.time <= PROGRAM_TIME(pcb->program[n]);
+}
@@ -0,0 +1,73 @@
+/*
+ * program.h
+ * Multithreaded OS Simulation - packed process programs
+ *
+ * A process's program is an array of 16-bit words that the simulator never
+ * writes, so that it lives in read-only memory, shared by every simulator
+ * running it, and a run leaves it as it found it.  Each process has a
+ * cursor instead (pcb_t.pc), holding its place in the program and the time
+ * left of its current operation.
+ *
+ * A word holds an operation: its op_type in the low PROGRAM_TYPE_BITS bits,
+ * and its time, up to PROGRAM_TIME_MAX, above them.  A run of operations
+ * that repeats is written once, followed by an OP_REPEAT word, which sends
+ * the cursor back over the length words before it count more times.  Runs
+ * may not contain OP_REPEAT words, so a cursor needs a single counter of
+ * the passes made over the run it is in.
+ */
+
+#ifndef __PROGRAM_H__
+#define __PROGRAM_H__
+
+#include "os-sim.h"
+
+
+#define PROGRAM_TYPE_BITS 3
+#define PROGRAM_TIME_MAX ((1 << (16 - PROGRAM_TYPE_BITS)) - 1)
+#define PROGRAM_LENGTH_BITS 6
+#define PROGRAM_LENGTH_MAX ((1 << PROGRAM_LENGTH_BITS) - 1)
+#define PROGRAM_COUNT_MAX (PROGRAM_TIME_MAX >> PROGRAM_LENGTH_BITS)
+
+/*
+ * PROGRAM_CHECK() is 0 if cond holds, and fails to compile otherwise, so
+ * that a program written with a time, length or count too big for its word
+ * is an error rather than silently truncated.  The operands must be
+ * constants, as they are in a program.
+ */
+#define PROGRAM_CHECK(cond, message) \
+    (0 * sizeof(struct { _Static_assert(cond, message); int unused; }))
+
+#define PROGRAM_OP(type, time) \
+    ((program_word_t)((time) << PROGRAM_TYPE_BITS | (type) | \
+        PROGRAM_CHECK((time) >= 0 && (time) <= PROGRAM_TIME_MAX, \
+                      "operation time out of range")))
+#define PROGRAM_REPEAT(length, count) \
+    PROGRAM_OP(OP_REPEAT, (count) << PROGRAM_LENGTH_BITS | (length) | \
+        PROGRAM_CHECK((length) >= 1 && (length) <= PROGRAM_LENGTH_MAX && \
+                      (count) >= 1 && (count) <= PROGRAM_COUNT_MAX, \
+                      "repeat length or count out of range"))
+
+#define PROGRAM_TYPE(word) ((op_type)((word) & ((1 << PROGRAM_TYPE_BITS) - 1)))
+#define PROGRAM_TIME(word) ((int)((word) >> PROGRAM_TYPE_BITS))
+
+
+/*
+ * program_reset() puts a process's cursor on the first operation of its
+ *   program.
+ *
+ * program_op() returns the type of a process's current operation.
+ *
+ * program_next() moves a process's cursor to its next operation, through
+ *   any OP_REPEAT word, and sets the time left to that operation's time.
+ *
+ * program_valid() returns whether a process's cursor is on an operation of
+ *   its program, with no more than that operation's time left, as one read
+ *   back from a checkpoint must be.
+ */
+extern void program_reset(pcb_t *pcb);
+extern op_type program_op(const pcb_t *pcb);
+extern void program_next(pcb_t *pcb);
+extern int program_valid(const pcb_t *pcb);
+
+
+#endif /* __PROGRAM_H__ */
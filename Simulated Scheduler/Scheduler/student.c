@@ -7,73 +7,530 @@
  */
 
 #include <assert.h>
+#include <dlfcn.h>
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "energy.h"
 #include "os-sim.h"
+#include "policy.h"
+#include "process.h"
 #include "student.h"
 
 // Local helper functions 
-static void addReadyProcess(pcb_t* proc); 
-static pcb_t* getReadyProcess(void); 
+static const sched_policy_t* loadPolicy(const char *path);
+static void preemptLowest(int *priorities, unsigned int count);
 static void schedule(unsigned int cpu_id);
+static int adaptiveTimeSlice(void);
+static void recordResponse(pcb_t *proc, unsigned int response);
+static void recordBurst(unsigned int cpu_id, int preempted);
+static pcb_t* getGangProcess(unsigned int cpu_id, int *slice);
+static int gangDispatchable(void);
+static void releaseGangCpu(unsigned int cpu_id);
+static void preemptGang(unsigned int cpu_id, pcb_t *proc);
+static pcb_t* getCgroupProcess(unsigned int cpu_id, int *slice);
+static int pickCgroup(unsigned int now);
+static void chargeCgroup(unsigned int cpu_id, pcb_t *proc);
+static void enqueueCgroup(pcb_t *proc, int delta);
+static pcb_t* getCapacityProcess(unsigned int cpu_id, int *slice);
+static pcb_t* pickCapacityProcess(unsigned int cpu_id, pcb_t **prevOut);
+static int fitsCpu(pcb_t *proc, unsigned int cpu_id);
+static int cpuWaiting(pcb_t *proc, unsigned int cpu_id, int bigger);
+static int siblingBusy(unsigned int cpu_id);
+static int coreWaiting(unsigned int cpu_id);
+static void trackUtilization(unsigned int cpu_id, pcb_t *proc, unsigned int burst);
+static void pullProcess(unsigned int cpu_id);
+static int idleCpusBelow(unsigned int cpu_id);
+static void setGovernorFrequency(unsigned int cpu_id);
+static void enterIdleState(unsigned int cpu_id);
+static void leaveIdleState(unsigned int cpu_id);
 
-int schedulerType; // 0 is FCFS, 1 is Round Robin, 2 is Static Priority
-int timeSlice; // Keeps track of the timeslice
+// Defaults for the adaptive Round Robin scheduler, in ticks
+#define DEFAULT_TARGET_LATENCY 12
+#define DEFAULT_MIN_GRANULARITY 2
+
+// Ticks of history the ondemand governor keeps before halving it
+#define GOVERNOR_WINDOW 20
+
+// Default for the Static Priority scheduler's aging
+#define DEFAULT_AGING_CAP 10
+
+// Utilization of a process keeping a full-capacity CPU busy
+#define CAPACITY_SCALE 1024
+
+// Most combined utilization of two processes co-scheduled on SMT siblings
+#define SMT_COMPATIBLE (CAPACITY_SCALE * 5 / 4)
+
+int schedulerType; // 0 is FCFS, 1 is Round Robin, 2 is Static Priority, 3 is Adaptive Round Robin, 4 is Gang,
+                   // 5 is Hierarchical Fair Share, 6 is Classifying Round Robin, 7 is Capacity-aware
+static const sched_policy_t *policy = NULL; // Picks READY processes, NULL for Gang, Fair Share and Capacity-aware
+int timeSlice; // Keeps track of the timeslice (the gang slot length for the Gang scheduler)
 int cpu_count; // Keeps track of the number of CPUs (required to check for empty CPUs in problem 3)
 
+int targetLatency = DEFAULT_TARGET_LATENCY; // Period in which every ready process should run once
+int minGranularity = DEFAULT_MIN_GRANULARITY; // Shortest time slice handed out by adaptive RR
+static unsigned int *dispatchTime; // Simulator time at which each CPU was last dispatched
+static int *cpuPriority; // Priority of each CPU's process while preempting for a batch
+static unsigned int burstEstimate = 0; // Rolling average of recent CPU bursts, in 1/8 ticks
+
+/*
+ * Response times, from a process waking up to its dispatch, by the class its
+ * name gives (0 interactive, 1 CPU-bound), whatever the scheduler.  A
+ * process's wake-up time is set under ready_mutex and read once it has been
+ * taken off the ready queue; the totals are protected by current_mutex.
+ */
+static unsigned int wokenAt[PROCESS_COUNT]; // Simulator time at which each process last woke up
+static char awaitingDispatch[PROCESS_COUNT]; // Whether it has not run since
+static unsigned long long responseTotal[2];
+static unsigned int responseCount[2], responseMax[2];
+
+/*
+ * Gang scheduler state, protected by ready_mutex.  A CPU is free from the
+ * moment its process leaves it until it is handed a new one.  When a gang
+ * is dispatched, its other members are reserved on free CPUs in gangNext[]
+ * and those CPUs pick them up from idle().
+ */
+static unsigned int *gangSize; // Number of processes in each group
+static unsigned int *gangReady; // Number of processes of each group in the ready queue
+static char *cpuFree; // Whether each CPU is free to take a process
+static int freeCpus; // Number of free CPUs
+static pcb_t **gangNext; // Process reserved on each CPU by a gang dispatch
+static unsigned int *gangSlotEnd; // Tick at which the reserved process's gang slot ends
+static int *gangPreempted; // Scratch for preemptGang(), PROCESS_COUNT CPUs for each CPU
+
+/*
+ * Hierarchical Fair Share scheduler state for each group in cgroups[],
+ * protected by ready_mutex.  At every level of the tree, the runnable child
+ * with the least weighted CPU time (vruntime) is picked.  Quotas work like a
+ * pool of run time: each dispatch reserves its time slice from the pool of
+ * every ancestor with a quota, unused time is given back when the process
+ * leaves the CPU, and a group whose pool is empty is throttled until its next
+ * period starts.
+ */
+typedef struct {
+  unsigned long long vruntime; // CPU time used, scaled by 1024 / weight
+  unsigned long long minVruntime; // vruntime of the child picked last
+  unsigned int runnable; // READY processes in the group's subtree
+  unsigned int usage; // Ticks of CPU used by the group's subtree
+  unsigned int period; // Index of the current quota period
+  int quotaLeft; // Ticks of quota not yet reserved in this period
+  int throttled; // Whether the group has run out of quota
+  unsigned int throttledSince; // Tick at which the group was throttled
+  unsigned int throttleTime; // Ticks spent throttled
+} cgroupState_t;
+
+static cgroupState_t cgroupState[CGROUP_COUNT];
+static int *cgroupSlice; // Quota reserved by each CPU's dispatch
+
+/*
+ * Capacity-aware scheduler state, protected by ready_mutex.  A process's
+ * utilization is the share of a full-capacity CPU it kept busy while it was
+ * not READY, in 1/CAPACITY_SCALE, as a moving average (weight 1/4) updated
+ * whenever it leaves a CPU.  Time spent READY is left out, so that a
+ * CPU-bound process doesn't look light because it had to wait for a CPU.
+ * A process fits a CPU if its utilization leaves the CPU 20% headroom.
+ * With SMT-aware placement, two processes are compatible on the siblings
+ * of a core if their utilizations add up to no more than SMT_COMPATIBLE, so
+ * that they seldom run at the same time.
+ */
+static unsigned int *cpuCapacity; // Capacity of each CPU, in 1/CAPACITY_SCALE
+static unsigned int maxCapacity; // Capacity of the biggest CPUs
+static int mixedCapacity; // Whether some CPUs are smaller than others
+static unsigned int utilization[PROCESS_COUNT]; // Utilization of each process
+static unsigned int utilSince[PROCESS_COUNT]; // Simulator time the utilization was last updated
+static unsigned int readySince[PROCESS_COUNT]; // Simulator time each process last became READY
+static unsigned int readyTime[PROCESS_COUNT]; // Ticks READY since utilSince
+static char tracked[PROCESS_COUNT]; // Whether the process has arrived
+static int lastCpu[PROCESS_COUNT]; // CPU each process last ran on, -1 if none
+static int *cpuPulling; // CPU each CPU preempted to take its process, plus 1
+static int *cpuSibling; // SMT sibling of each CPU, -1 if none
+static pcb_t **cpuProcess; // Process each CPU was last handed, NULL once it left
+int smtAware = 0; // Whether to fill cores before siblings and pair compatible processes
+static unsigned int bigTime[PROCESS_COUNT]; // Ticks run on the biggest CPUs
+static unsigned int runTime[PROCESS_COUNT]; // Ticks run
+static unsigned int upMigrations, downMigrations, pulls;
+
+/*
+ * Energy policy state.  cpuIdle[] is protected by ready_mutex; the governor
+ * and idle history of a CPU is only touched by that CPU's own thread.
+ */
+int energyPolicy = 0; // 0 is none (full speed), 1 is consolidate, 2 is ondemand, 3 is race
+static char *cpuIdle; // Whether each CPU is waiting in idle()
+static unsigned int *busyEnd; // Simulator time at which each CPU last went idle
+static unsigned int *governorBusy; // Recent busy ticks of each CPU
+static unsigned int *governorTotal; // Recent ticks of each CPU
+static char *cpuAsleep; // Whether each CPU is in the idle state race put it in
+static unsigned int *idleStart; // Simulator time at which each CPU fell asleep
+static unsigned int *idleEstimate; // Rolling average of each CPU's idle time, in 1/8 ticks
+
+/*
+ * Static Priority scheduler options, handed to the policy (see
+ * policy-priority.c).
+ */
+int agingRate = 0; // Ticks of waiting per level gained, 0 disables aging
+int agingCap = DEFAULT_AGING_CAP; // Most levels a process can gain
+int priorityInheritance = 0; // Whether lock owners inherit their waiters' priority
+
+/*
+ * usage() prints the command line syntax of the simulator.
+ */
+static void usage(void)
+{
+  fprintf(stderr, "Multithreaded OS Simulator\n"
+  "Usage: ./os-sim <# CPUs> [ -r <time slice> | -a | -p | -G <time slice> |\n"
+  "                          -c <time slice> | -b <time slice> |\n"
+  "                          -H <time slice> ] [ options ]\n"
+  "    Default : FCFS Scheduler\n"
+  "         -r : Round-Robin Scheduler\n"
+  "         -a : Adaptive Round-Robin Scheduler\n"
+  "         -p : Static Priority Scheduler\n"
+  "         -G : Gang Scheduler\n"
+  "         -c : Hierarchical Fair Share Scheduler (shares and quotas)\n"
+  "         -b : Round-Robin Scheduler classifying processes as interactive\n"
+  "              or batch from their behavior\n"
+  "         -H : Round-Robin Scheduler placing processes on CPUs by capacity\n"
+  "  Options:\n"
+  "    -l <ticks> : adaptive RR target latency (default %d)\n"
+  "    -g <ticks> : adaptive RR minimum granularity (default %d)\n"
+  "    -e race|consolidate|ondemand : energy policy (default none, every\n"
+  "         CPU runs at full speed)\n"
+  "    -C <capacity>[,<capacity>...] : CPU capacities in 1/1000ths of the\n"
+  "                 fastest CPU, in order of id, the last one repeated for\n"
+  "                 the other CPUs (default 1000)\n"
+  "    -S <throughput> : CPUs 2n and 2n+1 are SMT siblings, each running at\n"
+  "                 <throughput>/1000 of its speed while both are busy\n"
+  "                 (default no SMT)\n"
+  "    -t : with -H, fill idle cores before SMT siblings and pair compatible\n"
+  "         processes on siblings\n"
+  "    -A <ticks> : static priority aging, ticks READY per level gained\n"
+  "                 (default off)\n"
+  "    -M <levels> : most levels gained by aging (default %d)\n"
+  "    -k : the processes take the simulated locks in their programs\n"
+  "         (default they skip them)\n"
+  "    -i : with -k, static priority inheritance through the simulated\n"
+  "         mutexes\n"
+  "    -m <frames> : paged memory of the given number of frames\n"
+  "                  (default unlimited)\n"
+  "    -w <model> : process arrivals, fixed:<ticks> | poisson:<rate> |\n"
+  "                 onoff:<rate>,<on>,<off> | diurnal:<rate>,<period> |\n"
+  "                 trace:<file> (default fixed:10, rates per tick)\n"
+  "    -s <seed> : seed for random arrivals (default 1)\n"
+  "    -O <switch>,<migrate>,<decide>[,<per ready>] : ticks of CPU time lost\n"
+  "                 to each switch, migration and scheduler decision, plus\n"
+  "                 per process left READY (default none)\n"
+  "    -D <scheduler>[,<full>[,<settle>]] : seek to each I/O request's block,\n"
+  "                 in the order of scheduler fifo | scan | clook | deadline,\n"
+  "                 with seeks of settle to full ticks (default 1, 0.1)\n"
+  "    -P <name> : publish live metrics in shared memory object <name>,\n"
+  "                e.g. /os-sim, for ./os-stat <name> to poll\n"
+  "    -L <file> : load the scheduling policy used in place of FCFS, RR or\n"
+  "                SP from a shared object, e.g. ./policy-priority.so\n"
+  "    -K <file>[:<tick>] : checkpoint the simulation to <file> at <tick>,\n"
+  "                         and whenever it gets SIGUSR1\n"
+  "    -R <file> : restore the simulation from checkpoint <file>\n"
+  "    -T <file> : record the Gantt chart in <file>, for ./os-timeline\n"
+  "    -F <workers> : run the CPUs as fibers on <workers> threads rather than\n"
+  "                   each on a thread of its own, for up to 16384 CPUs\n"
+  "                   (default 0, threads)\n\n",
+  DEFAULT_TARGET_LATENCY, DEFAULT_MIN_GRANULARITY, DEFAULT_AGING_CAP);
+}
+
 /*
  * main() simply parses command line arguments, then calls start_simulator().
- * Supports the -r and -p modifiers, but does not error check and assumes the user knows the syntax if 
- * they enter an input of length 2, 3 or 4 
+ * The first argument is always the number of CPUs, followed by an optional
+ * scheduler selection and any number of options.
  */
 int main(int argc, char *argv[])
 {
-  // Parse command-line arguments and set cpu_count
-  if (argc == 2) {
-    schedulerType = 0;
+  int i, frames = 0, seed = 1, checkpointTick = 0, smt = 0, workers = 0;
+  int lockWorkload = 0;
+  const char *arrivals = NULL, *metrics = NULL, *restore = NULL, *plugin = NULL;
+  const char *timeline = NULL, *overhead = NULL, *capacities = NULL;
+  const char *diskModel = NULL;
+  policy_config_t config;
+  char *checkpoint = NULL, *colon;
+
+  if (argc < 2) {
+    usage();
+    return -1;
   }
-  else if (argc == 4) {
-    if (strcmp(argv[2], "-r") == 0)
-    {
+
+  // Parse command-line arguments and set cpu_count
+  schedulerType = 0;
+  for (i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
       schedulerType = 1;
-      timeSlice = atoi(argv[3]);
-    }
-    else {
-      fprintf(stderr, "3Multithreaded OS Simulator\n"
-      "Usage: ./os-sim <# CPUs> [ -r <time slice> | -p ]\n"
-      "    Default : FCFS Scheduler\n"
-      "         -r : Round-Robin Scheduler\n"
-      "         -p : Static Priority Scheduler\n\n");
-      return -1;      
+      timeSlice = atoi(argv[++i]);
     }
-  }
-  else if (argc == 3) {
-    if (strcmp(argv[2], "-p") == 0) {
+    else if (strcmp(argv[i], "-p") == 0) {
       schedulerType = 2;
     }
+    else if (strcmp(argv[i], "-a") == 0) {
+      schedulerType = 3;
+    }
+    else if (strcmp(argv[i], "-G") == 0 && i + 1 < argc) {
+      schedulerType = 4;
+      timeSlice = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+      schedulerType = 5;
+      timeSlice = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      schedulerType = 6;
+      timeSlice = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+      schedulerType = 7;
+      timeSlice = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+      targetLatency = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+      minGranularity = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-A") == 0 && i + 1 < argc) {
+      agingRate = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-M") == 0 && i + 1 < argc) {
+      agingCap = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-k") == 0) {
+      lockWorkload = 1;
+    }
+    else if (strcmp(argv[i], "-i") == 0) {
+      priorityInheritance = 1;
+    }
+    else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+      arrivals = argv[++i];
+    }
+    else if (strcmp(argv[i], "-P") == 0 && i + 1 < argc) {
+      metrics = argv[++i];
+    }
+    else if (strcmp(argv[i], "-K") == 0 && i + 1 < argc) {
+      checkpoint = argv[++i];
+      colon = strrchr(checkpoint, ':');
+      if (colon != NULL) {
+        *colon = '\0';
+        checkpointTick = atoi(colon + 1);
+      }
+    }
+    else if (strcmp(argv[i], "-L") == 0 && i + 1 < argc) {
+      plugin = argv[++i];
+    }
+    else if (strcmp(argv[i], "-R") == 0 && i + 1 < argc) {
+      restore = argv[++i];
+    }
+    else if (strcmp(argv[i], "-T") == 0 && i + 1 < argc) {
+      timeline = argv[++i];
+    }
+    else if (strcmp(argv[i], "-O") == 0 && i + 1 < argc) {
+      overhead = argv[++i];
+    }
+    else if (strcmp(argv[i], "-D") == 0 && i + 1 < argc) {
+      diskModel = argv[++i];
+    }
+    else if (strcmp(argv[i], "-C") == 0 && i + 1 < argc) {
+      capacities = argv[++i];
+    }
+    else if (strcmp(argv[i], "-S") == 0 && i + 1 < argc) {
+      smt = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-F") == 0 && i + 1 < argc) {
+      workers = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-t") == 0) {
+      smtAware = 1;
+    }
+    else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      seed = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      frames = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      i++;
+      if (strcmp(argv[i], "race") == 0) {
+        energyPolicy = 3;
+      }
+      else if (strcmp(argv[i], "consolidate") == 0) {
+        energyPolicy = 1;
+      }
+      else if (strcmp(argv[i], "ondemand") == 0) {
+        energyPolicy = 2;
+      }
+      else {
+        usage();
+        return -1;
+      }
+    }
     else {
-      fprintf(stderr, "3Multithreaded OS Simulator\n"
-      "Usage: ./os-sim <# CPUs> [ -r <time slice> | -p ]\n"
-      "    Default : FCFS Scheduler\n"
-      "         -r : Round-Robin Scheduler\n"
-      "         -p : Static Priority Scheduler\n\n");
-      return -1;      
+      usage();
+      return -1;
     }
   }
   cpu_count = atoi(argv[1]);
 
-  // Allocate the current[] array 
-  current = malloc(sizeof(pcb_t*) * cpu_count);
+  if (targetLatency < 1 || minGranularity < 1 || agingRate < 0 || agingCap < 0 ||
+      frames < 0 || checkpointTick < 0 || workers < 0 ||
+      ((schedulerType == 4 || schedulerType == 5 || schedulerType == 7) && timeSlice < 1) ||
+      ((schedulerType == 4 || schedulerType == 5 || schedulerType == 7) && plugin != NULL) ||
+      (smtAware && schedulerType != 7) ||
+      (capacities != NULL && set_cpu_capacities(capacities) < 0) ||
+      (smt != 0 && set_smt_throughput(smt) < 0) ||
+      (workers != 0 && set_fiber_workers(workers) < 0)) {
+    usage();
+    return -1;
+  }
+
+  // Pick the policy that selects READY processes; Gang, Fair Share and
+  // Capacity-aware select from the ready list themselves
+  if (plugin != NULL) {
+    policy = loadPolicy(plugin);
+    if (policy == NULL) {
+      return -1;
+    }
+  }
+  else if (schedulerType == 2) {
+    policy = &priority_policy;
+  }
+  else if (schedulerType == 6) {
+    policy = &classify_policy;
+  }
+  else if (schedulerType != 4 && schedulerType != 5 && schedulerType != 7) {
+    policy = &fifo_policy;
+  }
+  if (policy != NULL) {
+    config.cpu_count = cpu_count;
+    config.time_slice = schedulerType == 1 || schedulerType == 6 ? timeSlice : -1;
+    config.aging_rate = agingRate;
+    config.aging_cap = agingCap;
+    config.priority_inheritance = priorityInheritance;
+    if (policy->init(&config) < 0) {
+      fprintf(stderr, "The %s policy can't run with these options\n\n", policy->name);
+      return -1;
+    }
+  }
+
+  // Allocate the current[] array, every CPU idle, and the per-CPU dispatch times
+  current = calloc(cpu_count, sizeof(pcb_t*));
   assert(current != NULL);
+  dispatchTime = calloc(cpu_count, sizeof(unsigned int));
+  cpuPriority = calloc(cpu_count, sizeof(int));
+  assert(dispatchTime != NULL && cpuPriority != NULL);
+
+  // Size the process groups and mark every CPU free for the Gang scheduler
+  int groups = 1;
+  for (i = 0; i < PROCESS_COUNT; i++) {
+    if (processes[i].group >= groups) {
+      groups = processes[i].group + 1;
+    }
+  }
+  gangSize = calloc(groups, sizeof(unsigned int));
+  gangReady = calloc(groups, sizeof(unsigned int));
+  assert(gangSize != NULL && gangReady != NULL);
+  for (i = 0; i < PROCESS_COUNT; i++) {
+    gangSize[processes[i].group]++;
+  }
+  for (i = 1; i < groups; i++) {
+    if (schedulerType == 4 && gangSize[i] > cpu_count) {
+      fprintf(stderr, "Process group %d needs %u CPUs\n\n", i, gangSize[i]);
+      return -1;
+    }
+  }
+  cpuFree = malloc(cpu_count);
+  gangNext = calloc(cpu_count, sizeof(pcb_t*));
+  gangSlotEnd = calloc(cpu_count, sizeof(unsigned int));
+  gangPreempted = calloc((size_t)cpu_count * PROCESS_COUNT, sizeof(int));
+  assert(cpuFree != NULL && gangNext != NULL && gangSlotEnd != NULL &&
+         gangPreempted != NULL);
+  memset(cpuFree, 1, cpu_count);
+  freeCpus = cpu_count;
+
+  // Every scheduling group starts with a full quota
+  cgroupSlice = calloc(cpu_count, sizeof(int));
+  assert(cgroupSlice != NULL);
+  for (i = 0; i < CGROUP_COUNT; i++) {
+    cgroupState[i].quotaLeft = cgroups[i].quota;
+  }
+
+  // Every CPU starts idle, with no governor or idle history
+  cpuIdle = malloc(cpu_count);
+  busyEnd = calloc(cpu_count, sizeof(unsigned int));
+  governorBusy = calloc(cpu_count, sizeof(unsigned int));
+  governorTotal = calloc(cpu_count, sizeof(unsigned int));
+  cpuAsleep = calloc(cpu_count, 1);
+  idleStart = calloc(cpu_count, sizeof(unsigned int));
+  idleEstimate = calloc(cpu_count, sizeof(unsigned int));
+  assert(cpuIdle != NULL && busyEnd != NULL && governorBusy != NULL &&
+         governorTotal != NULL && cpuAsleep != NULL && idleStart != NULL &&
+         idleEstimate != NULL);
+  memset(cpuIdle, 1, cpu_count);
+
+  // Scale the CPU capacities for the Capacity-aware scheduler; a process
+  // starts at half the utilization of a big CPU until it has run
+  cpuCapacity = calloc(cpu_count, sizeof(unsigned int));
+  cpuPulling = calloc(cpu_count, sizeof(int));
+  cpuSibling = calloc(cpu_count, sizeof(int));
+  cpuProcess = calloc(cpu_count, sizeof(pcb_t*));
+  assert(cpuCapacity != NULL && cpuPulling != NULL && cpuSibling != NULL &&
+         cpuProcess != NULL);
+  maxCapacity = 0;
+  for (i = 0; i < cpu_count; i++) {
+    cpuCapacity[i] = get_cpu_capacity(i) * CAPACITY_SCALE / 1000;
+    if (cpuCapacity[i] > maxCapacity) {
+      maxCapacity = cpuCapacity[i];
+    }
+    cpuSibling[i] = get_cpu_sibling(i) < cpu_count ? get_cpu_sibling(i) : -1;
+  }
+  mixedCapacity = 0;
+  for (i = 0; i < cpu_count; i++) {
+    if (cpuCapacity[i] < maxCapacity) {
+      mixedCapacity = 1;
+    }
+  }
+  for (i = 0; i < PROCESS_COUNT; i++) {
+    utilization[i] = CAPACITY_SCALE / 2;
+    lastCpu[i] = -1;
+  }
 
   // Initialize necessary mutexes
-  pthread_mutex_init(&current_mutex, NULL);
-  pthread_mutex_init(&ready_mutex, NULL);
-  pthread_cond_init(&ready_empty, NULL);
+  LOCKSTAT_MUTEX_INIT(&current_mutex, "current_mutex");
+  LOCKSTAT_MUTEX_INIT(&ready_mutex, "ready_mutex");
+  fiber_cond_init(&ready_empty);
 
   // Start the simulator 
+  set_memory_frames(frames);
+  if (lockWorkload) {
+    set_lock_workload();
+  }
+  if (set_arrival_model(arrivals, seed) < 0) {
+    usage();
+    return -1;
+  }
+  if (set_overhead_model(overhead) < 0) {
+    usage();
+    return -1;
+  }
+  if (set_disk_model(diskModel) < 0) {
+    usage();
+    return -1;
+  }
+  if (metrics != NULL && set_metrics_name(metrics) < 0) {
+    return -1;
+  }
+  if (checkpoint != NULL) {
+    set_checkpoint(checkpoint, checkpointTick);
+  }
+  if (restore != NULL) {
+    set_restore(restore);
+  }
+  if (timeline != NULL) {
+    set_timeline(timeline);
+  }
   printf("starting simulator\n");
   fflush(stdout);
   start_simulator(cpu_count);
@@ -84,15 +541,44 @@ int main(int argc, char *argv[])
 /*
  * idle() is called by the simulator when the idle process is scheduled.
  * It blocks until a process is added to the ready queue, and then calls
- * schedule() to select the next process to run on the CPU.
+ * schedule() to select the next process to run on the CPU.  With the Gang
+ * scheduler it blocks until a gang fits or a process is reserved on this CPU,
+ * with the Fair Share scheduler until a group that isn't throttled has a
+ * process READY, and with the Capacity-aware scheduler until a process is
+ * left for it (see pickCapacityProcess()).  With the consolidate energy
+ * policy, a CPU leaves READY processes to the idle CPUs with lower ids, so
+ * that the CPUs with higher ids stay idle long enough to reach their deeper
+ * idle states.
  */
 extern void idle(unsigned int cpu_id)
 {
-  pthread_mutex_lock(&ready_mutex);
-  while (head == NULL) {
-    pthread_cond_wait(&ready_empty, &ready_mutex);
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  cpuIdle[cpu_id] = 1;
+  if (schedulerType == 4) {
+    while (gangNext[cpu_id] == NULL && !gangDispatchable()) {
+      LOCKSTAT_COND_WAIT(&ready_empty, &ready_mutex);
+    }
   }
-  pthread_mutex_unlock(&ready_mutex);
+  else if (schedulerType == 5) {
+    while (pickCgroup(get_simulator_time()) < 0) {
+      LOCKSTAT_COND_WAIT(&ready_empty, &ready_mutex);
+    }
+  }
+  else if (schedulerType == 7) {
+    while (pickCapacityProcess(cpu_id, NULL) == NULL) {
+      LOCKSTAT_COND_WAIT(&ready_empty, &ready_mutex);
+    }
+    // the CPUs that left their processes to this one may have to take them
+    fiber_cond_broadcast(&ready_empty);
+  }
+  else {
+    while (readyCount == 0 ||
+           (energyPolicy == 1 && readyCount <= idleCpusBelow(cpu_id))) {
+      LOCKSTAT_COND_WAIT(&ready_empty, &ready_mutex);
+    }
+  }
+  cpuIdle[cpu_id] = 0;
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
   schedule(cpu_id);
 }
 
@@ -108,25 +594,56 @@ extern void idle(unsigned int cpu_id)
  *      with a pointer to NULL to select the idle process.
  */
 static void schedule(unsigned int cpu_id) {
-  int i = -1;
-  // If the user selects the Round Robin Scheduler
-  if (schedulerType == 1) {
-    i = timeSlice;
+  int i = -1, adaptiveSlice = 0;
+  // The adaptive Round Robin scheduler recomputes the slice on every dispatch,
+  // from the load before the process is taken off the ready queue
+  if (schedulerType == 3) {
+    adaptiveSlice = adaptiveTimeSlice();
+  }
+
+  pcb_t *newProcess;
+  if (schedulerType == 4) {
+    newProcess = getGangProcess(cpu_id, &i);
+  }
+  else if (schedulerType == 5) {
+    newProcess = getCgroupProcess(cpu_id, &i);
+  }
+  else if (schedulerType == 7) {
+    newProcess = getCapacityProcess(cpu_id, &i);
+  }
+  else {
+    // the policy gives the time slice
+    newProcess = getReadyProcess(cpu_id, &i);
+    if (schedulerType == 3) {
+      i = adaptiveSlice;
+    }
   }
-  
-  pcb_t *newProcess = getReadyProcess();
 
   // If there is a process in the Ready Queue, run the "idle" process
   if (newProcess == NULL){
+    if (energyPolicy == 3) {
+      enterIdleState(cpu_id);
+    }
     context_switch(cpu_id, newProcess, -1);
   }
   else {
-    pthread_mutex_lock(&current_mutex);
+    LOCKSTAT_MUTEX_LOCK(&current_mutex);
 
-    newProcess->state = PROCESS_RUNNING;
+    set_process_state(newProcess, PROCESS_RUNNING);
     current[cpu_id] = newProcess;
+    dispatchTime[cpu_id] = get_simulator_time();
+    if (awaitingDispatch[newProcess->pid]) {
+      awaitingDispatch[newProcess->pid] = 0;
+      recordResponse(newProcess, dispatchTime[cpu_id] - wokenAt[newProcess->pid]);
+    }
 
-    pthread_mutex_unlock(&current_mutex);
+    LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+    if (energyPolicy == 2) {
+      setGovernorFrequency(cpu_id);
+    }
+    else if (energyPolicy == 3) {
+      leaveIdleState(cpu_id);
+    }
     context_switch(cpu_id, newProcess, i);
   }
 }
@@ -136,16 +653,30 @@ static void schedule(unsigned int cpu_id) {
  * preempted due to its timeslice expiring.
  *
  * It places the currently running process back in the ready queue, then calls 
- * schedule() and selects a new runnable process.
+ * schedule() and selects a new runnable process.  With the Gang scheduler the
+ * rest of the process's group is preempted along with it.  With the
+ * Capacity-aware scheduler, a CPU that would go idle first pulls a process
+ * from another CPU (see pullProcess()), here and in yield() and terminate().
  */
 extern void preempt(unsigned int cpu_id) {
-  pthread_mutex_lock(&current_mutex);
+  LOCKSTAT_MUTEX_LOCK(&current_mutex);
   
   pcb_t* currentProcess = current[cpu_id];
-  currentProcess->state = PROCESS_READY;
-  addReadyProcess(currentProcess);
+  recordBurst(cpu_id, 1);
+  if (schedulerType == 5) {
+    chargeCgroup(cpu_id, currentProcess);
+  }
+  set_process_state(currentProcess, PROCESS_READY);
+  addReadyProcess(currentProcess, 0);
 
-  pthread_mutex_unlock(&current_mutex);
+  LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+  if (schedulerType == 4) {
+    releaseGangCpu(cpu_id);
+    preemptGang(cpu_id, currentProcess);
+  }
+  if (schedulerType == 7) {
+    pullProcess(cpu_id);
+  }
   schedule(cpu_id);
 }
 
@@ -158,13 +689,23 @@ extern void preempt(unsigned int cpu_id) {
  * a new process for the CPU.
  */
 extern void yield(unsigned int cpu_id) {
-  pthread_mutex_lock(&current_mutex);
+  LOCKSTAT_MUTEX_LOCK(&current_mutex);
 
   pcb_t* currentProcess = current[cpu_id];
+  recordBurst(cpu_id, 0);
+  if (schedulerType == 5) {
+    chargeCgroup(cpu_id, currentProcess);
+  }
   current[cpu_id] = NULL;
-  currentProcess->state = PROCESS_WAITING;
+  set_process_state(currentProcess, PROCESS_WAITING);
 
-  pthread_mutex_unlock(&current_mutex);
+  LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+  if (schedulerType == 4) {
+    releaseGangCpu(cpu_id);
+  }
+  if (schedulerType == 7) {
+    pullProcess(cpu_id);
+  }
   schedule(cpu_id);
 }
 
@@ -176,173 +717,1149 @@ extern void yield(unsigned int cpu_id) {
  * a new process for the CPU.
  */
 extern void terminate(unsigned int cpu_id) { 
-  pthread_mutex_lock(&current_mutex); 
+  LOCKSTAT_MUTEX_LOCK(&current_mutex); 
 
   pcb_t* currentProcess = current[cpu_id];
+  recordBurst(cpu_id, 0);
+  if (schedulerType == 5) {
+    chargeCgroup(cpu_id, currentProcess);
+  }
   current[cpu_id] = NULL;
-  currentProcess->state = PROCESS_TERMINATED;
+  set_process_state(currentProcess, PROCESS_TERMINATED);
 
-  pthread_mutex_unlock(&current_mutex);
+  LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+  if (schedulerType == 4) {
+    // the rest of the gang no longer waits for this process
+    LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+    gangSize[currentProcess->group]--;
+    LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+    releaseGangCpu(cpu_id);
+  }
+  if (schedulerType == 7) {
+    pullProcess(cpu_id);
+  }
   schedule(cpu_id);
 }
 
 
 /*
- * wake_up() is the handler called by the simulator for a new process and when a 
- * process's I/O request completes.  It performs the following tasks depending on
- * the scheduler type:
+ * wake_up() is the handler called by the simulator for a new process and when a
+ * process's I/O request completes or it is handed a lock, if no other process
+ * wakes up in the same tick.  It performs the following tasks:
+ *
+ *   1. Mark the process as READY, and insert it into the ready queue
  *
- * FCFS and RR: Mark the process as READY, and insert it into the ready queue
+ *   2. If the policy compares priorities (SP), check whether any of the CPUs
+ *      are currently idle, and if so, run the process on the idle CPU
  *
- * SP:  1. Mark the process as READY, and insert it into the ready queue
-        2. Check whether any of the CPUs are currently idle, and if so, run the process
-            on the idle CPU
-        3. If none of the CPUs are idle, find the CPU running the lowest priority process,
-            and check whether the priority number of this process is lower than the 
-            process just woken up. If so, call force_preempt on this CPU. 
+ *   3. If none of the CPUs are idle, find the CPU running the lowest priority
+ *      process, and check whether its priority is lower than the process just
+ *      woken up's. If so, call force_preempt on this CPU.
  */
 extern void wake_up(pcb_t *process) {
+  int priority;
 
-  if (schedulerType != 2) {    
-    process->state = PROCESS_READY;
-    addReadyProcess(process);
+  set_process_state(process, PROCESS_READY);
+  addReadyProcess(process, 1);
+  if (policy != NULL && policy->priority != NULL) {
+    priority = policy->priority(process);
+    preemptLowest(&priority, 1);
   }
-  else {
-    int i = 0;
-    int priorityNumber = process->static_priority;
-    process->state = PROCESS_READY;
-    addReadyProcess(process);
-    // Check whether any of the CPUs are currently idle
-    while(i < cpu_count) {
-      if (current[i] == NULL) {
-        return;
-      }
-      i++;
+}
+
+/*
+ * wake_up_batch() is the handler called by the simulator in place of
+ * wake_up() when several processes wake up in the same tick, with all of
+ * them.  It performs the tasks of wake_up() for the whole batch at once:
+ *
+ *   1. Mark the processes as READY, and insert them into the ready queue in
+ *      one pass
+ *
+ *   2. If the policy compares priorities (SP), leave the processes of the
+ *      highest priorities to the CPUs that are currently idle
+ *
+ *   3. For each process left, highest priority first, find the CPU running
+ *      the lowest priority process not preempted yet, and call force_preempt
+ *      on it if that priority is lower than the process's.
+ */
+extern void wake_up_batch(pcb_t **processes, unsigned int count) {
+  int priorities[PROCESS_COUNT];
+  unsigned int i;
+
+  for (i = 0; i < count; i++) {
+    set_process_state(processes[i], PROCESS_READY);
+  }
+  addReadyProcesses(processes, count, 1);
+  if (policy != NULL && policy->priority != NULL) {
+    for (i = 0; i < count; i++) {
+      priorities[i] = policy->priority(processes[i]);
+    }
+    preemptLowest(priorities, count);
+  }
+}
+
+/*
+ * preemptLowest() performs steps 2 and 3 of wake_up_batch(), for count READY
+ * processes of the given priorities, which it sorts highest first.
+ */
+static void preemptLowest(int *priorities, unsigned int count) {
+  unsigned int i, j, idleCpus = 0;
+  int prio;
+
+  // Sort the priorities, highest first; a batch is at most PROCESS_COUNT
+  for (i = 1; i < count; i++) {
+    prio = priorities[i];
+    for (j = i; j > 0 && priorities[j - 1] < prio; j--) {
+      priorities[j] = priorities[j - 1];
+    }
+    priorities[j] = prio;
+  }
+
+  // current[] changes as the other CPUs switch, read it all at once.  The
+  // priority is the one the policy compares (SP counts the levels a process
+  // gained by aging); an idle CPU is never preempted
+  LOCKSTAT_MUTEX_LOCK(&current_mutex);
+  for (i = 0; i < cpu_count; i++) {
+    if (current[i] == NULL) {
+      idleCpus++;
+      cpuPriority[i] = 9999;
     }
+    else {
+      cpuPriority[i] = policy->priority(current[i]);
+    }
+  }
+  LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+
+  // The idle CPUs take the processes of the highest priorities themselves
+  for (j = idleCpus; j < count; j++) {
     // Find the CPU running the process with the lowest priority number
     int lowestCPUPrio = 9999;
     int lowestPrioCPU = -1;
     for (i = 0; i < cpu_count; i++) {
-      if (current[i]->static_priority < lowestCPUPrio) {
-        lowestCPUPrio = current[i]->static_priority;
+      if (cpuPriority[i] < lowestCPUPrio) {
+        lowestCPUPrio = cpuPriority[i];
         lowestPrioCPU = i;
       }
     }
-    // Checks whether this CPU's process's priority number is lower than the priority of 
-    //the proces just woken up, and call force_preempt on the CPU if so. 
-    if (current[lowestPrioCPU]->static_priority < priorityNumber) {
-      force_preempt(lowestPrioCPU);
+    // The rest of the batch is of no higher priority, so it preempts no one
+    // either
+    if (lowestCPUPrio >= priorities[j]) {
+      break;
     }
+    // This CPU will run a process of at least this priority from now on
+    force_preempt(lowestPrioCPU);
+    cpuPriority[lowestPrioCPU] = priorities[j];
   }
 }
 
+/*
+ * priority_changed() is the handler called by the simulator when the
+ * priority a process inherits through the simulated mutexes it holds
+ * changes.  With priority inheritance, the SP policy moves a READY process
+ * to the list of its new priority, and a CPU is preempted for it if it now
+ * outranks a running process.  A running process is simply compared at its
+ * new priority from now on.
+ */
+extern void priority_changed(pcb_t *process) {
+  int moved;
 
-/* The following 2 functions implement a FIFO ready queue of processes */
+  if (policy == NULL || policy->priority_changed == NULL) {
+    return;
+  }
 
-/* 
- * addReadyProcess takes no arguments and returns the first process in the ready 
- * queue, or NULL if the ready queue is empty. It performs the following tasks depending on
- * the scheduler type:  
- * 
- * FCFS and RR: add a process to the end of a pseudo linked list. 
- * 
- * SP: Traverse the list, and insert the new process such that it is behind all processes that
- *      share the same priority number as itself. 
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  moved = policy->priority_changed(process);
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+
+  if (moved && policy->priority != NULL) {
+    int priority = policy->priority(process);
+    preemptLowest(&priority, 1);
+  }
+}
+
+
+/*
+ * recordBurst() folds the length of the burst that just ended on a CPU into
+ * the rolling burst estimate used by the adaptive Round Robin scheduler.
+ * The estimate is an exponentially weighted moving average (weight 1/8) kept
+ * in fixed point with 3 fractional bits.  It also tells the policy how long
+ * the process ran and whether it was preempted, or the Capacity-aware
+ * scheduler how busy it kept the CPU.  Must be called with current_mutex
+ * held, before current[] is cleared.
  */
-static void addReadyProcess(pcb_t* proc) {
-  // ensure no other process can access ready list while we update it
-  pthread_mutex_lock(&ready_mutex);
+static void recordBurst(unsigned int cpu_id, int preempted) {
+  unsigned int now = get_simulator_time();
+  unsigned int burst = now - dispatchTime[cpu_id];
 
-  // for FCFS and RR schedulers
-  if (schedulerType != 2) {
-    // add this process to the end of the ready list
-    if (head == NULL) {
-      head = proc;
-      tail = proc;
-      proc->next = NULL;
-      // if list was empty may need to wake up idle process
-      pthread_cond_signal(&ready_empty);
-    }
-    else {
-      tail->next = proc;
-      tail = proc;
+  busyEnd[cpu_id] = now;
+  governorBusy[cpu_id] += burst;
+  governorTotal[cpu_id] += burst;
+
+  if (burstEstimate == 0) {
+    burstEstimate = burst << 3;
+  }
+  else {
+    burstEstimate = burstEstimate - (burstEstimate >> 3) + burst;
+  }
+
+  if (policy != NULL && policy->ran != NULL) {
+    LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+    policy->ran(current[cpu_id], burst, preempted);
+    LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+  }
+  if (schedulerType == 7) {
+    trackUtilization(cpu_id, current[cpu_id], burst);
+  }
+}
+
+/*
+ * recordResponse() adds the time a process waited from waking up to being
+ * dispatched to the response times of its class.  Must be called with
+ * current_mutex held.
+ */
+static void recordResponse(pcb_t *proc, unsigned int response) {
+  int c = proc->name[0] == 'I' ? 0 : 1;
+
+  responseTotal[c] += response;
+  responseCount[c]++;
+  if (response > responseMax[c]) {
+    responseMax[c] = response;
+  }
+}
+
+/*
+ * adaptiveTimeSlice() derives the time slice for the next dispatch from the
+ * current load:
+ *
+ *   1. The scheduling period is targetLatency, stretched to
+ *      nr * minGranularity once there are too many runnable processes to
+ *      give each one minGranularity ticks, so that the number of context
+ *      switches per tick stays bounded under heavy load.
+ *
+ *   2. Each runnable process gets an equal share of the period.
+ *
+ *   3. When lightly loaded, that is when the period did not need to be
+ *      stretched, the share is trimmed to 1.5x the recent burst estimate so
+ *      that a CPU hog cannot hold the CPU much longer than a typical burst
+ *      while a newly woken interactive process waits.  The slice never
+ *      drops below minGranularity.
+ *
+ * It is called before the process to dispatch leaves the ready queue, so
+ * readyCount already counts it.
+ */
+static int adaptiveTimeSlice(void) {
+  int nr, period, slice, estimate;
+
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  nr = readyCount > 0 ? readyCount : 1;
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+
+  LOCKSTAT_MUTEX_LOCK(&current_mutex);
+  estimate = (int)((burstEstimate + (burstEstimate >> 1) + 7) >> 3);
+  LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+
+  period = targetLatency;
+  if (nr * minGranularity > period) {
+    period = nr * minGranularity;
+  }
+  slice = period / nr;
+
+  if (period == targetLatency && estimate > 0 && estimate < slice) {
+    slice = estimate;
+  }
+  if (slice < minGranularity) {
+    slice = minGranularity;
+  }
+  return slice;
+}
+
+
+/*
+ * gangFits() checks whether the unit proc belongs to can be dispatched now:
+ * a process outside any group needs one free CPU, a gang needs all of its
+ * members READY and one free CPU for each.  Must be called with ready_mutex
+ * held.
+ */
+static int gangFits(pcb_t *proc) {
+  if (proc->group == 0) {
+    return freeCpus >= 1;
+  }
+  return gangReady[proc->group] == gangSize[proc->group] &&
+         freeCpus >= (int)gangSize[proc->group];
+}
+
+/*
+ * gangDispatchable() checks whether any unit in the ready queue fits.  Must
+ * be called with ready_mutex held.
+ */
+static int gangDispatchable(void) {
+  pcb_t* proc;
+
+  for (proc = head; proc != NULL; proc = proc->next) {
+    if (gangFits(proc)) {
+      return 1;
     }
-    // ensure that this proc points to NULL
-    proc->next = NULL;
   }
-  // for the SP scheduler
+  return 0;
+}
+
+/*
+ * removeReadyProcess() unlinks proc, which follows prev (or is the head if
+ * prev is NULL), from the ready queue.  Must be called with ready_mutex held.
+ */
+static void removeReadyProcess(pcb_t* proc, pcb_t* prev) {
+  if (prev == NULL) {
+    head = proc->next;
+  }
   else {
-    // add this process to the ready list if the list is empty
-    if (head == NULL) {
-      head = proc;
-      tail = proc;
-      proc->next = NULL;
-      // if list was empty may need to wake up idle process
-      pthread_cond_signal(&ready_empty);
+    prev->next = proc->next;
+  }
+  if (tail == proc) {
+    tail = prev;
+  }
+  proc->next = NULL;
+  readyCount--;
+  gangReady[proc->group]--;
+}
+
+/*
+ * getGangProcess() selects the next process for a CPU under the Gang
+ * scheduler:
+ *
+ *   1. A process reserved on this CPU by a gang dispatch runs for what is
+ *      left of its gang's slot, so the whole gang is preempted together.
+ *
+ *   2. Otherwise the first unit in the ready queue that fits is dispatched
+ *      for a slot of timeSlice ticks.  For a gang, this CPU takes the first
+ *      member and every other member is reserved on another free CPU, whose
+ *      idle() is then woken up, for the same slot.
+ *
+ * Returns NULL and leaves the CPU free if nothing fits.
+ */
+static pcb_t* getGangProcess(unsigned int cpu_id, int *slice) {
+  unsigned int now = get_simulator_time();
+  pcb_t *proc, *prev = NULL, *member, *memberPrev, *next;
+  int cpu;
+
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+
+  if (gangNext[cpu_id] != NULL) {
+    proc = gangNext[cpu_id];
+    gangNext[cpu_id] = NULL;
+    *slice = gangSlotEnd[cpu_id] > now ? (int)(gangSlotEnd[cpu_id] - now) : 1;
+    LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+    return proc;
+  }
+
+  for (proc = head; proc != NULL; prev = proc, proc = proc->next) {
+    if (gangFits(proc)) {
+      break;
     }
-    else {
-      pcb_t* currentProc = head;
-
-      /*
-       * if this process has a priority number greater than all processes,  
-       * replace the head with this process
-       */
-      if (proc->static_priority > currentProc->static_priority) {
-        proc->next = currentProc;
-        head = proc;
+  }
+  if (proc == NULL) {
+    LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+    return NULL;
+  }
+
+  removeReadyProcess(proc, prev);
+  cpuFree[cpu_id] = 0;
+  freeCpus--;
+  gangSlotEnd[cpu_id] = now + timeSlice;
+  *slice = timeSlice;
+
+  if (proc->group != 0) {
+    cpu = 0;
+    memberPrev = prev;
+    member = prev == NULL ? head : prev->next;
+    for (; member != NULL; member = next) {
+      next = member->next;
+      if (member->group != proc->group) {
+        memberPrev = member;
+        continue;
       }
-      /*
-       * traverse the list and place this process behind any process that has
-       * a priority number that is the same or greater than this process. 
-       */ 
-      else {
-        while (currentProc->next != NULL) {
-          if (proc->static_priority > currentProc->next->static_priority) {
-            proc->next = currentProc->next;
-            currentProc->next = proc;
-            pthread_mutex_unlock(&ready_mutex);
-            return;
+      removeReadyProcess(member, memberPrev);
+      while (!cpuFree[cpu]) {
+        cpu++;
+      }
+      cpuFree[cpu] = 0;
+      freeCpus--;
+      gangNext[cpu] = member;
+      gangSlotEnd[cpu] = now + timeSlice;
+    }
+    fiber_cond_broadcast(&ready_empty);
+  }
+
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+  return proc;
+}
+
+/*
+ * releaseGangCpu() marks a CPU free once its process has left it, and wakes
+ * up idle CPUs in case a gang now fits.
+ */
+static void releaseGangCpu(unsigned int cpu_id) {
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  cpuFree[cpu_id] = 1;
+  freeCpus++;
+  fiber_cond_broadcast(&ready_empty);
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+}
+
+/*
+ * preemptGang() preempts the members of proc's group that are still running
+ * on other CPUs, so that a gang always leaves the CPUs together.  Each of
+ * them is a different process, so there are at most PROCESS_COUNT.
+ */
+static void preemptGang(unsigned int cpu_id, pcb_t *proc) {
+  int *cpus = &gangPreempted[cpu_id * PROCESS_COUNT];
+  int n = 0, i;
+
+  if (proc->group == 0) {
+    return;
+  }
+
+  LOCKSTAT_MUTEX_LOCK(&current_mutex);
+  for (i = 0; i < cpu_count; i++) {
+    if (i != cpu_id && current[i] != NULL && current[i]->group == proc->group &&
+        current[i]->state == PROCESS_RUNNING) {
+      cpus[n++] = i;
+    }
+  }
+  LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+
+  for (i = 0; i < n; i++) {
+    force_preempt(cpus[i]);
+  }
+}
+
+
+/*
+ * fitsCpu() checks whether a process's utilization leaves a CPU 20%
+ * headroom.  Must be called with ready_mutex held.
+ */
+static int fitsCpu(pcb_t *proc, unsigned int cpu_id) {
+  return utilization[proc->pid] * 5 <= cpuCapacity[cpu_id] * 4;
+}
+
+/*
+ * cpuWaiting() checks whether a CPU other than cpu_id is waiting for a
+ * process: idle, or about to take a process it pulled.  With bigger set, the
+ * CPU must be bigger than cpu_id; otherwise it must be smaller, and proc must
+ * fit it.  Must be called with ready_mutex held.
+ */
+static int cpuWaiting(pcb_t *proc, unsigned int cpu_id, int bigger) {
+  int n;
+
+  for (n = 0; n < cpu_count; n++) {
+    if (n == cpu_id || (!cpuIdle[n] && cpuPulling[n] == 0)) {
+      continue;
+    }
+    if (bigger ? cpuCapacity[n] > cpuCapacity[cpu_id] :
+        cpuCapacity[n] < cpuCapacity[cpu_id] && fitsCpu(proc, n)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * siblingBusy() checks whether a CPU's SMT sibling is busy, that is not
+ * waiting in idle().  Must be called with ready_mutex held.
+ */
+static int siblingBusy(unsigned int cpu_id) {
+  return cpuSibling[cpu_id] >= 0 && !cpuIdle[cpuSibling[cpu_id]];
+}
+
+/*
+ * coreWaiting() checks whether a CPU at least as big as cpu_id is waiting
+ * for a process on a core whose other sibling is idle.  Must be called with
+ * ready_mutex held.
+ */
+static int coreWaiting(unsigned int cpu_id) {
+  int n;
+
+  for (n = 0; n < cpu_count; n++) {
+    if (n != cpu_id && (cpuIdle[n] || cpuPulling[n] != 0) &&
+        cpuCapacity[n] >= cpuCapacity[cpu_id] && !siblingBusy(n)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/*
+ * pickCapacityProcess() finds the process a CPU should take under the
+ * Capacity-aware scheduler, and stores the process before it in the ready
+ * list in *prevOut (if not NULL).  In ready list order:
+ *
+ *   1. A process that doesn't fit the CPU is left to a bigger CPU waiting for
+ *      one (up-migration).
+ *
+ *   2. A process that fits is left to a smaller CPU waiting for one that it
+ *      also fits (down-migration), so that big CPUs are kept for heavy work.
+ *
+ *   3. With SMT-aware placement, a CPU whose sibling is busy leaves every
+ *      process to a CPU waiting on an idle core, so cores fill up first.
+ *
+ *   4. Of the processes left, the first that fits no smaller CPU and, with
+ *      SMT-aware placement, is compatible with the process on the sibling
+ *      is taken; failing that, the first that fits no smaller CPU, the first
+ *      compatible one, or the first one.
+ *
+ * Returns NULL if every READY process is left to another CPU.  Must be called
+ * with ready_mutex held.
+ */
+static pcb_t* pickCapacityProcess(unsigned int cpu_id, pcb_t **prevOut) {
+  pcb_t *proc, *prev = NULL, *pick = NULL, *pickPrev = NULL, *partner = NULL;
+  int n, needsCpu, score, pickScore = -1;
+
+  if (smtAware && siblingBusy(cpu_id)) {
+    if (coreWaiting(cpu_id)) {
+      if (prevOut != NULL) {
+        *prevOut = NULL;
+      }
+      return NULL;
+    }
+    partner = cpuProcess[cpuSibling[cpu_id]];
+  }
+
+  for (proc = head; proc != NULL; prev = proc, proc = proc->next) {
+    if (fitsCpu(proc, cpu_id) ? cpuWaiting(proc, cpu_id, 0) :
+        cpuWaiting(proc, cpu_id, 1)) {
+      continue;
+    }
+
+    needsCpu = 1;
+    for (n = 0; n < cpu_count; n++) {
+      if (cpuCapacity[n] < cpuCapacity[cpu_id] && fitsCpu(proc, n)) {
+        needsCpu = 0;
+        break;
+      }
+    }
+    score = needsCpu * 2 + (partner == NULL ||
+            utilization[proc->pid] + utilization[partner->pid] <= SMT_COMPATIBLE);
+    if (score > pickScore) {
+      pick = proc;
+      pickPrev = prev;
+      pickScore = score;
+    }
+    if (score == 3) {
+      break;
+    }
+  }
+
+  if (prevOut != NULL) {
+    *prevOut = pickPrev;
+  }
+  return pick;
+}
+
+/*
+ * getCapacityProcess() selects the next process for a CPU under the
+ * Capacity-aware scheduler (see pickCapacityProcess()), and counts the
+ * migrations between CPUs of different capacities.  A CPU that pulled a
+ * process stops waiting for it, whether it takes it or not.
+ */
+static pcb_t* getCapacityProcess(unsigned int cpu_id, int *slice) {
+  unsigned int now = get_simulator_time();
+  pcb_t *proc, *prev;
+  int last;
+
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+
+  if (cpuPulling[cpu_id] != 0) {
+    cpuPulling[cpu_id] = 0;
+    fiber_cond_broadcast(&ready_empty);
+  }
+
+  proc = pickCapacityProcess(cpu_id, &prev);
+  if (proc == NULL) {
+    LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+    return NULL;
+  }
+
+  removeReadyProcess(proc, prev);
+  readyTime[proc->pid] += now - readySince[proc->pid];
+  last = lastCpu[proc->pid];
+  if (last >= 0 && cpuCapacity[last] < cpuCapacity[cpu_id]) {
+    upMigrations++;
+  }
+  else if (last >= 0 && cpuCapacity[last] > cpuCapacity[cpu_id]) {
+    downMigrations++;
+  }
+  lastCpu[proc->pid] = cpu_id;
+  cpuProcess[cpu_id] = proc;
+  *slice = timeSlice;
+
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+  return proc;
+}
+
+/*
+ * trackUtilization() folds the burst a process just ran on a CPU into its
+ * utilization.  The work is scaled by the CPU's capacity, so a process that
+ * keeps a little CPU busy doesn't fit it, and the time since the last update
+ * excludes the time spent READY.  Must be called with current_mutex held.
+ */
+static void trackUtilization(unsigned int cpu_id, pcb_t *proc, unsigned int burst) {
+  unsigned int now = get_simulator_time();
+  unsigned int pid = proc->pid, elapsed, sample;
+
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  runTime[pid] += burst;
+  if (cpuCapacity[cpu_id] == maxCapacity) {
+    bigTime[pid] += burst;
+  }
+  elapsed = now - utilSince[pid] - readyTime[pid];
+  if (elapsed > 0) {
+    sample = burst * cpuCapacity[cpu_id] / elapsed;
+    if (sample > CAPACITY_SCALE) {
+      sample = CAPACITY_SCALE;
+    }
+    utilization[pid] = utilization[pid] - (utilization[pid] >> 2) + (sample >> 2);
+  }
+  utilSince[pid] = now;
+  readyTime[pid] = 0;
+  cpuProcess[cpu_id] = NULL;
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+}
+
+/*
+ * pullProcess() is called before a CPU schedules under the Capacity-aware
+ * scheduler.  If no READY process is left for it, it preempts another CPU
+ * and waits for its process, which that CPU leaves to it as it is re-queued:
+ *
+ *   1. A smaller CPU running a process that doesn't fit there
+ *      (up-migration).
+ *
+ *   2. With SMT-aware placement, if this CPU's core is otherwise idle, a CPU
+ *      no bigger than this one whose sibling is busy too.
+ */
+static void pullProcess(unsigned int cpu_id) {
+  int n, j, pass, victim = -1;
+
+  LOCKSTAT_MUTEX_LOCK(&current_mutex);
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  if (pickCapacityProcess(cpu_id, NULL) == NULL) {
+    for (pass = 0; pass < 2 && victim < 0; pass++) {
+      for (n = 0; n < cpu_count && victim < 0; n++) {
+        if (n == cpu_id || current[n] == NULL || current[n]->state != PROCESS_RUNNING) {
+          continue;
+        }
+        if (pass == 0 ? cpuCapacity[n] >= cpuCapacity[cpu_id] || fitsCpu(current[n], n) :
+            !smtAware || (cpuSibling[cpu_id] >= 0 && current[cpuSibling[cpu_id]] != NULL) ||
+            cpuSibling[n] < 0 || current[cpuSibling[n]] == NULL ||
+            cpuCapacity[n] > cpuCapacity[cpu_id]) {
+          continue;
+        }
+        // another CPU may already be pulling this process
+        victim = n;
+        for (j = 0; j < cpu_count; j++) {
+          if (cpuPulling[j] == n + 1) {
+            victim = -1;
           }
-          currentProc = currentProc->next;
         }
-        /*
-         * if this process has a priority number lesser than all processes, 
-         * replace the tail with this process. 
-         */
-        currentProc->next = proc;
-        proc->next = NULL;
-        tail = proc;
       }
     }
+    if (victim >= 0) {
+      cpuPulling[cpu_id] = victim + 1;
+      pulls++;
+    }
+  }
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+  LOCKSTAT_MUTEX_UNLOCK(&current_mutex);
+
+  if (victim >= 0) {
+    force_preempt(victim);
   }
-  pthread_mutex_unlock(&ready_mutex);
 }
 
+
+/*
+ * refillCgroup() starts a new quota period for a group if one has begun since
+ * the group was last looked at, unthrottling it.  Must be called with
+ * ready_mutex held.
+ */
+static void refillCgroup(int g, unsigned int now) {
+  cgroupState_t *state = &cgroupState[g];
+  unsigned int period;
+
+  if (cgroups[g].quota == 0) {
+    return;
+  }
+  period = now / cgroups[g].period;
+  if (period == state->period) {
+    return;
+  }
+  if (state->throttled) {
+    state->throttleTime += period * cgroups[g].period - state->throttledSince;
+    state->throttled = 0;
+  }
+  state->period = period;
+  state->quotaLeft = cgroups[g].quota;
+}
+
+/*
+ * pickCgroup() walks down the group tree from the root, at each level taking
+ * the runnable, unthrottled child with the least vruntime.  Returns the leaf
+ * group to run a process from, or -1 if nothing may run.  Must be called with
+ * ready_mutex held.
+ */
+static int pickCgroup(unsigned int now) {
+  int g = 0, c, best;
+
+  for (c = 0; c < CGROUP_COUNT; c++) {
+    refillCgroup(c, now);
+  }
+  if (cgroupState[0].runnable == 0 || cgroupState[0].throttled) {
+    return -1;
+  }
+
+  while (1) {
+    best = -1;
+    for (c = 1; c < CGROUP_COUNT; c++) {
+      if (cgroups[c].parent == g && cgroupState[c].runnable > 0 &&
+          !cgroupState[c].throttled &&
+          (best < 0 || cgroupState[c].vruntime < cgroupState[best].vruntime)) {
+        best = c;
+      }
+    }
+    if (best < 0) {
+      break;
+    }
+    g = best;
+  }
+
+  // Only a group with processes of its own (a leaf) can be run from
+  for (c = 1; c < CGROUP_COUNT; c++) {
+    if (cgroups[c].parent == g) {
+      return -1;
+    }
+  }
+  return g;
+}
+
+/*
+ * enqueueCgroup() adds delta to the runnable count of a process's group and
+ * all of its ancestors.  A group that becomes runnable again starts no
+ * further behind than the sibling picked last, so it can't build up credit
+ * while it has nothing to run.  Must be called with ready_mutex held.
+ */
+static void enqueueCgroup(pcb_t *proc, int delta) {
+  int g;
+
+  for (g = proc->cgroup; g >= 0; g = cgroups[g].parent) {
+    if (delta > 0 && cgroupState[g].runnable == 0 && cgroups[g].parent >= 0 &&
+        cgroupState[g].vruntime < cgroupState[cgroups[g].parent].minVruntime) {
+      cgroupState[g].vruntime = cgroupState[cgroups[g].parent].minVruntime;
+    }
+    cgroupState[g].runnable += delta;
+  }
+}
+
+/*
+ * getCgroupProcess() selects the next process for a CPU under the Fair Share
+ * scheduler: the first READY process of the group picked by pickCgroup().
+ * Its time slice is cut short to what is left of the quota, and of the
+ * current period, of every ancestor with a quota, and is reserved from those
+ * quotas.  A group whose quota is used up is throttled until its next period,
+ * when policy_timer() wakes up the idle CPUs again.
+ */
+static pcb_t* getCgroupProcess(unsigned int cpu_id, int *slice) {
+  unsigned int now = get_simulator_time();
+  unsigned int periodEnd, wakeAt = 0;
+  pcb_t *proc, *prev = NULL;
+  int g, a, s = timeSlice;
+
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+
+  g = pickCgroup(now);
+  if (g < 0) {
+    LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+    return NULL;
+  }
+
+  for (proc = head; proc->cgroup != g; prev = proc, proc = proc->next);
+  if (prev == NULL) {
+    head = proc->next;
+  }
+  else {
+    prev->next = proc->next;
+  }
+  if (tail == proc) {
+    tail = prev;
+  }
+  proc->next = NULL;
+  readyCount--;
+  gangReady[proc->group]--;
+  enqueueCgroup(proc, -1);
+
+  for (a = g; a >= 0; a = cgroups[a].parent) {
+    if (cgroups[a].parent >= 0) {
+      cgroupState[cgroups[a].parent].minVruntime = cgroupState[a].vruntime;
+    }
+    if (cgroups[a].quota == 0) {
+      continue;
+    }
+    periodEnd = (cgroupState[a].period + 1) * cgroups[a].period;
+    if (s > cgroupState[a].quotaLeft) {
+      s = cgroupState[a].quotaLeft;
+    }
+    if (s > (int)(periodEnd - now)) {
+      s = periodEnd - now;
+    }
+  }
+
+  for (a = g; a >= 0; a = cgroups[a].parent) {
+    if (cgroups[a].quota == 0) {
+      continue;
+    }
+    cgroupState[a].quotaLeft -= s;
+    if (cgroupState[a].quotaLeft == 0) {
+      cgroupState[a].throttled = 1;
+      cgroupState[a].throttledSince = now;
+      periodEnd = (cgroupState[a].period + 1) * cgroups[a].period;
+      if (wakeAt == 0 || periodEnd < wakeAt) {
+        wakeAt = periodEnd;
+      }
+    }
+  }
+  cgroupSlice[cpu_id] = s;
+  *slice = s;
+
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+
+  if (wakeAt != 0) {
+    set_policy_timer(wakeAt);
+  }
+  return proc;
+}
+
+/*
+ * chargeCgroup() charges the CPU time a process just used to its group and
+ * all of its ancestors, and gives back the part of the reserved quota it did
+ * not use.  Must be called before the CPU's dispatch time is overwritten.
+ */
+static void chargeCgroup(unsigned int cpu_id, pcb_t *proc) {
+  unsigned int now = get_simulator_time();
+  unsigned int ran = now - dispatchTime[cpu_id];
+  int g, unused = cgroupSlice[cpu_id] - (int)ran;
+
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  for (g = proc->cgroup; g >= 0; g = cgroups[g].parent) {
+    cgroupState[g].usage += ran;
+    cgroupState[g].vruntime += (unsigned long long)ran * 1024 / cgroups[g].weight;
+    if (cgroups[g].quota == 0 || unused <= 0 ||
+        now / cgroups[g].period != dispatchTime[cpu_id] / cgroups[g].period) {
+      continue;
+    }
+    cgroupState[g].quotaLeft += unused;
+    if (cgroupState[g].throttled) {
+      cgroupState[g].throttleTime += now - cgroupState[g].throttledSince;
+      cgroupState[g].throttled = 0;
+      fiber_cond_broadcast(&ready_empty);
+    }
+  }
+  cgroupSlice[cpu_id] = 0;
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+}
+
+/*
+ * policy_timer() is the handler called by the simulator when the timer set
+ * with set_policy_timer() expires.  The Fair Share scheduler uses it at the
+ * start of a quota period: it wakes up the idle CPUs, which refill the quotas
+ * as they pick a group, and re-arms the timer for any group that is still
+ * throttled.
+ */
+extern void policy_timer(void) {
+  unsigned int now = get_simulator_time();
+  unsigned int wakeAt = 0, periodEnd;
+  int g;
+
+  if (schedulerType != 5) {
+    return;
+  }
+
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  for (g = 0; g < CGROUP_COUNT; g++) {
+    refillCgroup(g, now);
+    if (cgroupState[g].throttled) {
+      periodEnd = (cgroupState[g].period + 1) * cgroups[g].period;
+      if (wakeAt == 0 || periodEnd < wakeAt) {
+        wakeAt = periodEnd;
+      }
+    }
+  }
+  fiber_cond_broadcast(&ready_empty);
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+
+  if (wakeAt != 0) {
+    set_policy_timer(wakeAt);
+  }
+}
+
+/*
+ * idleCpusBelow() returns the number of CPUs with an id lower than cpu_id
+ * that are waiting in idle().  Must be called with ready_mutex held.
+ */
+static int idleCpusBelow(unsigned int cpu_id) {
+  unsigned int n;
+  int count = 0;
+
+  for (n = 0; n < cpu_id; n++) {
+    count += cpuIdle[n];
+  }
+  return count;
+}
+
+/*
+ * setGovernorFrequency() is the ondemand governor: it folds the time a CPU
+ * spent idle since its last burst into the CPU's recent history, and picks
+ * the slowest frequency level that still leaves 25% headroom over the CPU's
+ * recent utilization.  A CPU that runs slower stays busy longer, which raises
+ * its utilization, so a loaded CPU climbs back to full speed.  The history is
+ * halved whenever it grows past GOVERNOR_WINDOW ticks.
+ */
+static void setGovernorFrequency(unsigned int cpu_id) {
+  unsigned int now = get_simulator_time();
+  unsigned int utilization;
+  int level;
+
+  governorTotal[cpu_id] += now - busyEnd[cpu_id];
+  busyEnd[cpu_id] = now;
+  while (governorTotal[cpu_id] > GOVERNOR_WINDOW) {
+    governorBusy[cpu_id] >>= 1;
+    governorTotal[cpu_id] >>= 1;
+  }
+
+  // A CPU without history is assumed fully busy
+  utilization = governorTotal[cpu_id] == 0 ? 1000 :
+                governorBusy[cpu_id] * 1000 / governorTotal[cpu_id];
+  for (level = CPU_FREQ_LEVELS - 1; level > 0; level--) {
+    if (cpu_freq_speed[level] * 4 >= utilization * 5) {
+      break;
+    }
+  }
+  set_cpu_frequency(cpu_id, level);
+}
+
+/*
+ * enterIdleState() and leaveIdleState() are the race-to-idle policy.  Every
+ * CPU runs its bursts at the fastest frequency level, where CPUs start, so
+ * that it goes idle as soon as it can.  A CPU going idle is put straight
+ * into the deepest idle state its expected idle time reaches the target
+ * residency of, instead of sinking through the states one by one: a CPU
+ * expected to stay idle long saves the power of the shallow states on the
+ * way down, and one expected to wake soon doesn't pay the exit latency of a
+ * deep one.  A CPU that stays idle longer still sinks from there.  The
+ * expected idle time is a rolling average (weight 1/8, as for bursts) of
+ * the CPU's past idle intervals, folded in when the CPU is next given a
+ * process.
+ */
+static void enterIdleState(unsigned int cpu_id) {
+  unsigned int expected = idleEstimate[cpu_id] >> 3;
+  unsigned int cstate;
+
+  // A CPU still idle stays in the state it is in
+  if (cpuAsleep[cpu_id]) {
+    return;
+  }
+  cpuAsleep[cpu_id] = 1;
+  idleStart[cpu_id] = get_simulator_time();
+
+  for (cstate = CSTATE_COUNT - 1; cstate > 0; cstate--) {
+    if (expected >= cstates[cstate].residency) {
+      break;
+    }
+  }
+  set_idle_state(cpu_id, cstate);
+}
+
+static void leaveIdleState(unsigned int cpu_id) {
+  unsigned int idle;
+
+  if (!cpuAsleep[cpu_id]) {
+    return;
+  }
+  cpuAsleep[cpu_id] = 0;
+  idle = get_simulator_time() - idleStart[cpu_id];
+
+  if (idleEstimate[cpu_id] == 0) {
+    idleEstimate[cpu_id] = idle << 3;
+  }
+  else {
+    idleEstimate[cpu_id] = idleEstimate[cpu_id] - (idleEstimate[cpu_id] >> 3) + idle;
+  }
+}
+
+/*
+ * print_scheduler_stats() is called by the simulator after its own final
+ * statistics, to print the statistics kept by the scheduler.  end_time is the
+ * simulated time at which the run ended; the simulator is stopped, so
+ * get_simulator_time() can't be called here.
+ */
+extern void print_scheduler_stats(unsigned int end_time) {
+  const char *classNames[2] = { "interactive", "CPU-bound" };
+  int g;
+
+  // Response times by class only mean something to the classifying scheduler
+  if (schedulerType == 6) {
+    printf("\nResponse time    Wake-ups      Mean       Max\n");
+    for (g = 0; g < 2; g++) {
+      printf("%-14s %10u %7.2f s %7.1f s\n", classNames[g], responseCount[g],
+             responseCount[g] ?
+               (double)responseTotal[g] / responseCount[g] / 10.0 : 0.0,
+             (float)responseMax[g] / 10.0);
+    }
+  }
+
+  if (policy != NULL && policy->print_stats != NULL) {
+    policy->print_stats(end_time);
+  }
+
+  // Time on big CPUs only means something when some CPUs are smaller
+  if (schedulerType == 7) {
+    printf("\nProcess     Utilization%s\n",
+           mixedCapacity ? "  On big CPUs" : "");
+    for (g = 0; g < PROCESS_COUNT; g++) {
+      printf("%-10s %10.0f%%", processes[g].name,
+             utilization[g] * 100.0 / CAPACITY_SCALE);
+      if (mixedCapacity) {
+        printf(" %11.0f%%",
+               runTime[g] ? bigTime[g] * 100.0 / runTime[g] : 0.0);
+      }
+      printf("\n");
+    }
+    printf("Migrations: %u up, %u down, %u processes pulled off another CPU\n",
+           upMigrations, downMigrations, pulls);
+  }
+
+  if (schedulerType == 5) {
+    printf("\nScheduling group       CPU time    Throttled\n");
+    for (g = 0; g < CGROUP_COUNT; g++) {
+      if (cgroupState[g].throttled) {
+        cgroupState[g].throttleTime += end_time - cgroupState[g].throttledSince;
+        cgroupState[g].throttled = 0;
+      }
+      printf("%-20s %8.1f s %10.1f s\n", cgroups[g].name,
+             (float)cgroupState[g].usage / 10.0,
+             (float)cgroupState[g].throttleTime / 10.0);
+    }
+  }
+}
+
+
+/*
+ * The following 2 functions implement the ready queue of processes, which
+ * the policy orders.  Gang, Fair Share and Capacity-aware keep a FIFO ready
+ * list instead, and pick from it themselves.
+ */
+
 /* 
- * getReadyProcess removes a process from the front of a pseudo linked list. 
- * it takes no arguments and returns the first process in the ready queue, or NULL 
- * if the ready queue is empty. 
+ * addReadyProcess adds a process that became READY to the ready queue.  woken
+ * tells the policy whether the process starts a new burst or was preempted.
+ * It wakes up an idle CPU for the process.
  */
-static pcb_t* getReadyProcess(void) {
+static void addReadyProcess(pcb_t* proc, int woken) {
+  addReadyProcesses(&proc, 1, woken);
+}
+
+/*
+ * addReadyProcesses adds count processes that became READY to the ready
+ * queue in one pass, in order, taking the ready_mutex once.  It wakes up as
+ * many idle CPUs as there may be processes for.
+ */
+static void addReadyProcesses(pcb_t** procs, unsigned int count, int woken) {
+  unsigned int now = get_simulator_time();
+  unsigned int i;
+  pcb_t* proc;
+
   // ensure no other process can access ready list while we update it
-  pthread_mutex_lock(&ready_mutex);
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  for (i = 0; i < count; i++) {
+    proc = procs[i];
+    readyCount++;
+    gangReady[proc->group]++;
+    if (schedulerType == 5) {
+      enqueueCgroup(proc, 1);
+    }
+
+    if (woken) {
+      wokenAt[proc->pid] = now;
+      awaitingDispatch[proc->pid] = 1;
+    }
+    readySince[proc->pid] = now;
+    if (!tracked[proc->pid]) {
+      tracked[proc->pid] = 1;
+      utilSince[proc->pid] = now;
+    }
 
-  // if list is empty, unlock and return null
-  if (head == NULL) {
-	  pthread_mutex_unlock(&ready_mutex);
-	  return NULL;
+    if (policy != NULL) {
+      policy->enqueue(proc, woken, now);
+    }
+    else {
+      // add this process to the end of the ready list
+      proc->next = NULL;
+      if (head == NULL) {
+        head = proc;
+      }
+      else {
+        tail->next = proc;
+      }
+      tail = proc;
+    }
+  }
+  // a single CPU woken up may leave the process to a lower idle CPU when
+  // consolidating, a gang may have become complete, a group that isn't
+  // throttled may have work again, a process may be left to another CPU, or
+  // there may be work for several CPUs: wake up all idle CPUs to check.
+  // Otherwise an idle CPU may be waiting for this process
+  if (energyPolicy == 1 || policy == NULL || count > 1) {
+    fiber_cond_broadcast(&ready_empty);
+  }
+  else {
+    fiber_cond_signal(&ready_empty);
   }
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
+}
 
-  // get first process to return and update head to point to next process
-  pcb_t* first = head;
-  head = first->next;
+/* 
+ * getReadyProcess removes the process the policy picks for a CPU from the
+ * ready queue, and stores its time slice.  It returns NULL if the ready queue
+ * is empty.
+ */
+static pcb_t* getReadyProcess(unsigned int cpu_id, int *slice) {
+  unsigned int now = get_simulator_time();
+  pcb_t* first;
 
-  // if there was no next process, list is now empty, set tail to NULL
-  if (head == NULL) {
-    tail = NULL;
+  // ensure no other process can access ready list while we update it
+  LOCKSTAT_MUTEX_LOCK(&ready_mutex);
+  first = policy->dequeue(cpu_id, now, slice);
+  if (first != NULL) {
+    readyCount--;
+    gangReady[first->group]--;
   }
-
-  pthread_mutex_unlock(&ready_mutex);
+  LOCKSTAT_MUTEX_UNLOCK(&ready_mutex);
   return first;
 }
 
+/*
+ * loadPolicy() loads a scheduling policy built as a shared object, and
+ * returns the operations it exports, or NULL if it can't.
+ */
+static const sched_policy_t* loadPolicy(const char *path) {
+  const sched_policy_t **exported;
+  void *handle;
+
+  handle = dlopen(path, RTLD_NOW);
+  if (handle == NULL) {
+    fprintf(stderr, "%s\n\n", dlerror());
+    return NULL;
+  }
+  exported = dlsym(handle, "scheduler_policy");
+  if (exported == NULL || *exported == NULL) {
+    fprintf(stderr, "%s does not export a scheduler_policy\n\n", path);
+    return NULL;
+  }
+  return *exported;
+}
@@ -11,6 +11,8 @@
 #ifndef __STUDENT_H__
 #define __STUDENT_H__
 
+#include "fiber.h"
+#include "lockstat.h"
 #include "os-sim.h"
 
 /* Functions called from simulator - comments in student.c */
@@ -19,10 +21,15 @@ extern void preempt(unsigned int cpu_id);
 extern void yield(unsigned int cpu_id);
 extern void terminate(unsigned int cpu_id);
 extern void wake_up(pcb_t *process);
+extern void wake_up_batch(pcb_t **processes, unsigned int count);
+extern void policy_timer(void);
+extern void priority_changed(pcb_t *process);
+extern void print_scheduler_stats(unsigned int end_time);
 
 /* Functions available to use in student.c to manipulate ready queue */
-static void addReadyProcess(pcb_t* proc); 
-static pcb_t* getReadyProcess(void); 
+static void addReadyProcess(pcb_t* proc, int woken); 
+static void addReadyProcesses(pcb_t** procs, unsigned int count, int woken);
+static pcb_t* getReadyProcess(unsigned int cpu_id, int *slice); 
 
 /*
  * current[] is an array of pointers to the currently running processes.
@@ -34,16 +41,20 @@ static pcb_t* getReadyProcess(void);
  * for your use.
  */
 static pcb_t **current;
-static pthread_mutex_t current_mutex;
+static lockstat_mutex_t current_mutex;
 
-// head and tail of ready queue
+// head and tail of the Gang and Fair Share ready list
 static pcb_t* head = NULL;
 static pcb_t* tail = NULL;
 
+// number of processes in the ready queue
+static int readyCount = 0;
+
 // mutex to protect ready queue
-static pthread_mutex_t ready_mutex;
+static lockstat_mutex_t ready_mutex;
 
-// cond var for idle() to sleep on until a process is available on the ready queue
-static pthread_cond_t ready_empty;
+// cond var for idle() to sleep on until a process is available on the ready queue;
+// a fiber_cond_t, as idle() may run on a fiber (see fiber.h)
+static fiber_cond_t ready_empty;
 
 #endif /* __STUDENT_H__ */
@@ -0,0 +1,309 @@
+/*
+ * sync.c
+ * Multithreaded OS Simulation - simulated locks shared between processes
+ *
+ * See sync.h.  Everything here is only called by the simulator with the
+ * simulator_mutex held.  The processes waiting for a lock are kept in FIFO
+ * order, linked through wait_next[] since the PCB's next pointer belongs to
+ * the scheduler.  Checkpoints hold processes as pids, -1 for none.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "checkpoint.h"
+#include "sync.h"
+#include "process.h"
+
+
+typedef struct {
+    unsigned int available;
+    pcb_t *owner;
+    pcb_t *head, *tail;
+    unsigned int waiting;
+
+    unsigned int acquisitions;
+    unsigned int contended;
+    unsigned int wait_total;
+    unsigned int wait_max;
+    unsigned int waiting_max;
+} lock_state_t;
+
+static int locks_enabled = 0;
+static lock_state_t lock_state[LOCK_COUNT];
+
+static pcb_t *wait_next[PROCESS_COUNT];
+static unsigned int wait_since[PROCESS_COUNT];
+static int blocked_on[PROCESS_COUNT];
+
+/* Inherited priorities, and a stack of the processes whose one changed */
+static unsigned int inherited[PROCESS_COUNT];
+static char inherited_changed[PROCESS_COUNT];
+static pcb_t *changed[PROCESS_COUNT];
+static unsigned int changed_count = 0;
+
+
+extern void sync_init(int enabled)
+{
+    unsigned int n;
+
+    locks_enabled = enabled;
+    for (n=0; n<LOCK_COUNT; n++)
+        lock_state[n].available = locks[n].count;
+    for (n=0; n<PROCESS_COUNT; n++)
+        blocked_on[n] = -1;
+}
+
+extern int sync_enabled(void)
+{
+    return locks_enabled;
+}
+
+static unsigned int priority_of(pcb_t *pcb)
+{
+    return inherited[pcb->pid] > pcb->static_priority ?
+           inherited[pcb->pid] : pcb->static_priority;
+}
+
+/*
+ * update_inheritance() recomputes what the owner of a mutex inherits from
+ * the processes waiting for the mutexes it holds, and passes a change on to
+ * the owner of the mutex it is itself waiting for, if any.
+ */
+static void update_inheritance(pcb_t *owner)
+{
+    unsigned int n, priority;
+    pcb_t *w;
+
+    while (owner != NULL)
+    {
+        priority = 0;
+        for (n=0; n<LOCK_COUNT; n++)
+        {
+            if (lock_state[n].owner != owner)
+                continue;
+            for (w = lock_state[n].head; w != NULL; w = wait_next[w->pid])
+                if (priority_of(w) > priority)
+                    priority = priority_of(w);
+        }
+
+        if (priority == inherited[owner->pid])
+            return;
+        inherited[owner->pid] = priority;
+        if (!inherited_changed[owner->pid])
+        {
+            inherited_changed[owner->pid] = 1;
+            changed[changed_count++] = owner;
+        }
+
+        owner = blocked_on[owner->pid] >= 0 ?
+                lock_state[blocked_on[owner->pid]].owner : NULL;
+    }
+}
+
+extern int sync_acquire(pcb_t *pcb, unsigned int lock, unsigned int now)
+{
+    lock_state_t *l;
+
+    assert(lock < LOCK_COUNT);
+    l = &lock_state[lock];
+    l->acquisitions++;
+
+    if (l->available > 0)
+    {
+        l->available--;
+        if (locks[lock].count == 1)
+            l->owner = pcb;
+        return 1;
+    }
+
+    /* Wait at the end of the queue */
+    l->contended++;
+    wait_next[pcb->pid] = NULL;
+    if (l->tail == NULL)
+        l->head = pcb;
+    else
+        wait_next[l->tail->pid] = pcb;
+    l->tail = pcb;
+    if (++l->waiting > l->waiting_max)
+        l->waiting_max = l->waiting;
+    wait_since[pcb->pid] = now;
+    blocked_on[pcb->pid] = lock;
+
+    update_inheritance(l->owner);
+    return 0;
+}
+
+extern pcb_t* sync_release(pcb_t *pcb, unsigned int lock, unsigned int now)
+{
+    lock_state_t *l;
+    pcb_t *next;
+    unsigned int wait;
+
+    assert(lock < LOCK_COUNT);
+    l = &lock_state[lock];
+    assert(locks[lock].count != 1 || l->owner == pcb);
+
+    next = l->head;
+    if (next == NULL)
+    {
+        l->available++;
+        l->owner = NULL;
+        return NULL;
+    }
+
+    /* Hand the lock over to the first process waiting */
+    l->head = wait_next[next->pid];
+    if (l->head == NULL)
+        l->tail = NULL;
+    l->waiting--;
+    blocked_on[next->pid] = -1;
+
+    wait = now - wait_since[next->pid];
+    l->wait_total += wait;
+    if (wait > l->wait_max)
+        l->wait_max = wait;
+
+    if (locks[lock].count == 1)
+    {
+        l->owner = next;
+        update_inheritance(pcb);
+        update_inheritance(next);
+    }
+    return next;
+}
+
+extern pcb_t* sync_next_inherited(unsigned int *priority)
+{
+    pcb_t *pcb;
+
+    if (changed_count == 0)
+        return NULL;
+
+    pcb = changed[--changed_count];
+    inherited_changed[pcb->pid] = 0;
+    *priority = inherited[pcb->pid];
+    return pcb;
+}
+
+extern void sync_print_stats(void)
+{
+    unsigned int n;
+
+    if (!locks_enabled || LOCK_COUNT == 0)
+        return;
+
+    printf("\nLock         Acquired  Contended   Avg wait   Max wait  Max queue\n");
+    for (n=0; n<LOCK_COUNT; n++)
+    {
+        printf("%-12s %8u %10u %8.1f s %8.1f s %10u\n", locks[n].name,
+            lock_state[n].acquisitions, lock_state[n].contended,
+            lock_state[n].contended ?
+                (float)lock_state[n].wait_total / lock_state[n].contended / 10.0 : 0.0,
+            (float)lock_state[n].wait_max / 10.0, lock_state[n].waiting_max);
+    }
+}
+
+static void put_pcb(pcb_t *pcb)
+{
+    int pid = pcb != NULL ? (int)pcb->pid : -1;
+
+    CHECKPOINT_PUT(pid);
+}
+
+static pcb_t *get_pcb(void)
+{
+    int pid;
+
+    CHECKPOINT_GET(pid);
+    if (!checkpoint_check(pid >= -1 && pid < PROCESS_COUNT))
+        pid = -1;
+    return pid >= 0 ? &processes[pid] : NULL;
+}
+
+extern void sync_save(void)
+{
+    lock_state_t *l;
+    unsigned int n;
+    pcb_t *w;
+
+    CHECKPOINT_PUT(locks_enabled);
+    for (n=0; n<LOCK_COUNT; n++)
+    {
+        l = &lock_state[n];
+        CHECKPOINT_PUT(l->available);
+        put_pcb(l->owner);
+        CHECKPOINT_PUT(l->waiting);
+        for (w = l->head; w != NULL; w = wait_next[w->pid])
+            put_pcb(w);
+        CHECKPOINT_PUT(l->acquisitions);
+        CHECKPOINT_PUT(l->contended);
+        CHECKPOINT_PUT(l->wait_total);
+        CHECKPOINT_PUT(l->wait_max);
+        CHECKPOINT_PUT(l->waiting_max);
+    }
+    CHECKPOINT_PUT(wait_since);
+    CHECKPOINT_PUT(blocked_on);
+    CHECKPOINT_PUT(inherited);
+    CHECKPOINT_PUT(changed_count);
+    for (n=0; n<changed_count; n++)
+        put_pcb(changed[n]);
+}
+
+extern void sync_restore(void)
+{
+    lock_state_t *l;
+    unsigned int n, w, count;
+    pcb_t *pcb;
+
+    CHECKPOINT_GET(locks_enabled);
+    if (!checkpoint_check(locks_enabled == 0 || locks_enabled == 1))
+        locks_enabled = 0;
+    for (n=0; n<LOCK_COUNT; n++)
+    {
+        l = &lock_state[n];
+        CHECKPOINT_GET(l->available);
+        l->owner = get_pcb();
+        CHECKPOINT_GET(l->waiting);
+        if (!checkpoint_check(l->waiting <= PROCESS_COUNT))
+            l->waiting = 0;
+        l->head = l->tail = NULL;
+        for (w=0; w<l->waiting; w++)
+        {
+            if (!checkpoint_check((pcb = get_pcb()) != NULL))
+                continue;
+            wait_next[pcb->pid] = NULL;
+            if (l->tail == NULL)
+                l->head = pcb;
+            else
+                wait_next[l->tail->pid] = pcb;
+            l->tail = pcb;
+        }
+        CHECKPOINT_GET(l->acquisitions);
+        CHECKPOINT_GET(l->contended);
+        CHECKPOINT_GET(l->wait_total);
+        CHECKPOINT_GET(l->wait_max);
+        CHECKPOINT_GET(l->waiting_max);
+    }
+    CHECKPOINT_GET(wait_since);
+    CHECKPOINT_GET(blocked_on);
+    CHECKPOINT_GET(inherited);
+    for (n=0; n<PROCESS_COUNT; n++)
+        inherited_changed[n] = 0;
+    for (n=0; n<PROCESS_COUNT; n++)
+        if (!checkpoint_check(blocked_on[n] >= -1 &&
+                              blocked_on[n] < LOCK_COUNT))
+            blocked_on[n] = -1;
+    CHECKPOINT_GET(count);
+    if (!checkpoint_check(count <= PROCESS_COUNT))
+        count = 0;
+    changed_count = 0;
+    for (n=0; n<count; n++)
+    {
+        if (!checkpoint_check((pcb = get_pcb()) != NULL) ||
+            inherited_changed[pcb->pid])
+            continue;
+        inherited_changed[pcb->pid] = 1;
+        changed[changed_count++] = pcb;
+    }
+}
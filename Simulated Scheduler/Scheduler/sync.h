@@ -0,0 +1,58 @@
+/*
+ * sync.h
+ * Multithreaded OS Simulation - simulated locks shared between processes
+ *
+ * The locks in locks[] are counting semaphores; a lock with a count of 1 is
+ * a mutex, and has an owner.  OP_ACQUIRE takes a unit of a lock, or blocks
+ * the process until one is released; OP_RELEASE gives it back, handing it
+ * to the first process waiting for it.
+ *
+ * While processes wait for a mutex, its owner inherits the highest priority
+ * among them (their static priority or what they inherited themselves), so
+ * that a chain of owners all inherit the priority of the process at its end.
+ * Whether the scheduler uses the inherited priority is up to it.
+ *
+ * The locks are on only once set_lock_workload() has been called.  While
+ * they are off, OP_ACQUIRE and OP_RELEASE are skipped and no process ever
+ * waits.
+ */
+
+#ifndef __SYNC_H__
+#define __SYNC_H__
+
+#include "os-sim.h"
+
+
+/*
+ * sync_init() makes every lock available, and turns the locks on if
+ *   enabled is 1.
+ *
+ * sync_enabled() returns whether the locks are on.
+ *
+ * sync_acquire() takes a unit of a lock for a process at time now, and
+ *   returns 1, or queues the process and returns 0 if none is available.
+ *
+ * sync_release() gives back a unit of a lock, and returns the process it
+ *   was handed to, or NULL if none was waiting.
+ *
+ * sync_next_inherited() returns a process whose inherited priority changed,
+ *   and stores that priority, or returns NULL once there are no more.
+ *
+ * sync_print_stats() prints how contended each lock was, if the locks are
+ *   on.
+ *
+ * sync_save() and sync_restore() write the state of every lock, its queue
+ *   and the inherited priorities to the open checkpoint, and read them back,
+ *   whether the locks are on included.
+ */
+extern void sync_init(int enabled);
+extern int sync_enabled(void);
+extern int sync_acquire(pcb_t *pcb, unsigned int lock, unsigned int now);
+extern pcb_t* sync_release(pcb_t *pcb, unsigned int lock, unsigned int now);
+extern pcb_t* sync_next_inherited(unsigned int *priority);
+extern void sync_print_stats(void);
+extern void sync_save(void);
+extern void sync_restore(void);
+
+
+#endif /* __SYNC_H__ */
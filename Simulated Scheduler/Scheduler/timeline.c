@@ -0,0 +1,176 @@
+/*
+ * timeline.c
+ * Multithreaded OS Simulation - columnar timeline export
+ *
+ * See timeline.h.  Each column is encoded as its values are recorded, into
+ * a buffer that grows as needed; only the supervisor thread records.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "os-sim.h"
+#include "process.h"
+#include "timeline.h"
+
+
+/*
+ *   value  : the value of the run in progress
+ *   length : its number of ticks, 0 before the first tick of a block
+ *   last   : the value of the previous run written
+ *   data   : the runs written, size bytes out of capacity
+ */
+typedef struct {
+    uint32_t value;
+    uint32_t length;
+    uint32_t last;
+    uint8_t *data;
+    size_t size, capacity;
+} timeline_column_t;
+
+static FILE *file = NULL;
+static int failed;
+static unsigned int column_count;
+static timeline_column_t *columns;
+static timeline_block_t block;
+
+
+static void put_varint(timeline_column_t *column, uint64_t value)
+{
+    if (column->capacity - column->size < 10)
+    {
+        column->capacity = column->capacity ? column->capacity * 2 : 256;
+        column->data = realloc(column->data, column->capacity);
+        assert(column->data != NULL);
+    }
+    while (value >= 0x80)
+    {
+        column->data[column->size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    column->data[column->size++] = (uint8_t)value;
+}
+
+static void end_run(timeline_column_t *column)
+{
+    int64_t delta = (int64_t)column->value - column->last;
+
+    put_varint(column, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+    put_varint(column, column->length);
+    column->last = column->value;
+}
+
+static void write_block(void)
+{
+    uint32_t size;
+    unsigned int n;
+
+    if (block.tick_count == 0)
+        return;
+
+    for (n=0; n<column_count; n++)
+        end_run(&columns[n]);
+    if (fwrite(&block, sizeof(block), 1, file) != 1)
+        failed = 1;
+    for (n=0; n<column_count; n++)
+    {
+        size = columns[n].size;
+        if (fwrite(&size, sizeof(size), 1, file) != 1)
+            failed = 1;
+    }
+    for (n=0; n<column_count; n++)
+    {
+        if (columns[n].size > 0 &&
+            fwrite(columns[n].data, columns[n].size, 1, file) != 1)
+            failed = 1;
+        columns[n].size = 0;
+        columns[n].length = 0;
+        columns[n].last = 0;
+    }
+    block.tick_count = 0;
+}
+
+extern int timeline_open(const char *path, unsigned int cpu_count)
+{
+    timeline_header_t header;
+    uint8_t length;
+    unsigned int n;
+
+    file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        perror(path);
+        return -1;
+    }
+    failed = 0;
+    column_count = cpu_count + TIMELINE_COUNTS;
+    columns = calloc(column_count, sizeof(timeline_column_t));
+    assert(columns != NULL);
+    block.tick_count = 0;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, TIMELINE_MAGIC, sizeof(header.magic));
+    header.version = TIMELINE_VERSION;
+    header.cpu_count = cpu_count;
+    header.process_count = PROCESS_COUNT;
+    header.column_count = column_count;
+    if (fwrite(&header, sizeof(header), 1, file) != 1)
+        failed = 1;
+    for (n=0; n<PROCESS_COUNT; n++)
+    {
+        length = (uint8_t)strnlen(processes[n].name, 255);
+        if (fwrite(&length, 1, 1, file) != 1 ||
+            fwrite(processes[n].name, 1, length, file) != length)
+            failed = 1;
+    }
+    return 0;
+}
+
+extern void timeline_record(unsigned int tick, const uint32_t *values)
+{
+    timeline_column_t *column;
+    unsigned int n;
+
+    if (file == NULL)
+        return;
+
+    if (block.tick_count == TIMELINE_BLOCK_TICKS ||
+        (block.tick_count > 0 && tick != block.first_tick + block.tick_count))
+        write_block();
+    if (block.tick_count == 0)
+        block.first_tick = tick;
+    block.tick_count++;
+
+    for (n=0; n<column_count; n++)
+    {
+        column = &columns[n];
+        if (column->length > 0 && column->value == values[n])
+        {
+            column->length++;
+            continue;
+        }
+        if (column->length > 0)
+            end_run(column);
+        column->value = values[n];
+        column->length = 1;
+    }
+}
+
+extern int timeline_close(void)
+{
+    unsigned int n;
+
+    if (file == NULL)
+        return 0;
+
+    write_block();
+    if (fclose(file) != 0)
+        failed = 1;
+    file = NULL;
+    for (n=0; n<column_count; n++)
+        free(columns[n].data);
+    free(columns);
+    return failed ? -1 : 0;
+}
@@ -0,0 +1,78 @@
+/*
+ * timeline.h
+ * Multithreaded OS Simulation - columnar timeline export
+ *
+ * The simulator can record, for every tick, the same values as a line of
+ * the Gantt chart: the process on each CPU, the number of processes running,
+ * READY and waiting, and the length of the I/O queues.  The timeline is
+ * written in blocks of up to TIMELINE_BLOCK_TICKS consecutive ticks, and a
+ * block holds one column per value, so a reader skips the columns it does
+ * not need.  A file is laid out as:
+ *
+ *   timeline_header_t
+ *   process_count names, each a length byte followed by the characters
+ *   blocks, each a timeline_block_t followed by its columns' bytes
+ *
+ * The columns of a block are, in order: one per CPU, holding 1 + the pid of
+ * the process on it or 0 when it is idle, then the TIMELINE_RUNNING ...
+ * TIMELINE_PAGING_QUEUE columns.  A column is a list of runs of equal
+ * values, each encoded as two varints (7 bits per byte, least significant
+ * first, high bit set on every byte but the last): the difference from the
+ * previous run's value (the first run's from 0) in zigzag form, so that a
+ * small decrease is a small number too, and the number of ticks in the run.
+ * Fields are written in the simulator's byte order, as the format is meant
+ * to be read back on the same machine.
+ */
+
+#ifndef __TIMELINE_H__
+#define __TIMELINE_H__
+
+#include <stdint.h>
+
+
+#define TIMELINE_MAGIC "ossimtln"
+#define TIMELINE_VERSION 1
+#define TIMELINE_BLOCK_TICKS 65536
+
+/* The columns after the CPUs' */
+enum {
+    TIMELINE_RUNNING = 0,
+    TIMELINE_READY,
+    TIMELINE_WAITING,
+    TIMELINE_IO_QUEUE,
+    TIMELINE_PAGING_QUEUE,
+    TIMELINE_COUNTS
+};
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t cpu_count;
+    uint32_t process_count;
+    uint32_t column_count;       /* cpu_count + TIMELINE_COUNTS */
+} timeline_header_t;
+
+/* Followed by column_count byte counts, one per column */
+typedef struct {
+    uint32_t first_tick;
+    uint32_t tick_count;
+} timeline_block_t;
+
+
+/*
+ * timeline_open() creates the timeline file path for cpu_count CPUs, and
+ *   returns 0, or -1 if it can't.
+ *
+ * timeline_record() adds the values of a tick, one per column.  Ticks are
+ *   recorded in order; a tick that does not follow the last one starts a new
+ *   block.  It does nothing if timeline_open() was not called.
+ *
+ * timeline_close() writes the last block and closes the file, and returns 0,
+ *   or -1 if anything failed since timeline_open().
+ */
+extern int timeline_open(const char *path, unsigned int cpu_count);
+extern void timeline_record(unsigned int tick, const uint32_t *values);
+extern int timeline_close(void);
+
+
+#endif /* __TIMELINE_H__ */
@@ -0,0 +1,146 @@
+/*
+ * timerwheel.c
+ * Multithreaded OS Simulation - hierarchical timer wheel
+ *
+ * See timerwheel.h.
+ */
+
+#include <stddef.h>
+
+#include "timerwheel.h"
+
+
+static void timer_wheel_place(timer_wheel *wheel, sim_timer *timer)
+{
+    unsigned int delta = timer->expires - wheel->now;
+    unsigned int expires = timer->expires;
+    unsigned int level, shift;
+    sim_timer *head, *after;
+
+    /*
+     * Pick the lowest level whose range covers the timer.  Timers beyond the
+     * range of the top level are parked in the last slot the top level can
+     * reach; they are re-placed when that slot cascades.
+     */
+    for (level=0; level<TIMER_WHEEL_LEVELS - 1; level++)
+    {
+        if (delta < (1U << (TIMER_WHEEL_BITS * (level + 1))))
+            break;
+    }
+    shift = TIMER_WHEEL_BITS * level;
+    if (level == TIMER_WHEEL_LEVELS - 1 &&
+        delta >= (1U << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)))
+    {
+        expires = wheel->now + (1U << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+                  - 1;
+    }
+
+    /*
+     * A level 0 slot holds the timers of a single tick, kept in key order
+     * so that expiring takes the first one; timers mostly arrive in key
+     * order, so the place is found from the tail.  The other levels are
+     * sorted as they cascade down.
+     */
+    head = &wheel->slot[level][(expires >> shift) & TIMER_WHEEL_MASK];
+    after = head->prev;
+    if (level == 0)
+    {
+        while (after != head && after->key > timer->key)
+            after = after->prev;
+    }
+    timer->prev = after;
+    timer->next = after->next;
+    after->next->prev = timer;
+    after->next = timer;
+}
+
+static void timer_wheel_cascade(timer_wheel *wheel, unsigned int level)
+{
+    unsigned int shift = TIMER_WHEEL_BITS * level;
+    sim_timer *head = &wheel->slot[level][(wheel->now >> shift) &
+                                          TIMER_WHEEL_MASK];
+    sim_timer *timer, *next;
+
+    /* Detach the whole slot, then re-place each timer at a lower level */
+    timer = head->next;
+    head->next = head;
+    head->prev = head;
+    while (timer != head)
+    {
+        next = timer->next;
+        timer_wheel_place(wheel, timer);
+        timer = next;
+    }
+}
+
+
+extern void timer_wheel_init(timer_wheel *wheel, unsigned int now)
+{
+    unsigned int level, s;
+
+    wheel->now = now;
+    for (level=0; level<TIMER_WHEEL_LEVELS; level++)
+    {
+        for (s=0; s<TIMER_WHEEL_SLOTS; s++)
+        {
+            wheel->slot[level][s].next = &wheel->slot[level][s];
+            wheel->slot[level][s].prev = &wheel->slot[level][s];
+        }
+    }
+}
+
+extern void timer_wheel_add(timer_wheel *wheel, sim_timer *timer,
+                            unsigned int expires, unsigned int key)
+{
+    timer_wheel_cancel(timer);
+
+    /* A timer can't expire in a tick that has already been simulated */
+    if ((int)(expires - wheel->now) < 0)
+        expires = wheel->now;
+
+    timer->expires = expires;
+    timer->key = key;
+    timer_wheel_place(wheel, timer);
+}
+
+extern void timer_wheel_cancel(sim_timer *timer)
+{
+    if (!timer_pending(timer))
+        return;
+
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->next = NULL;
+    timer->prev = NULL;
+}
+
+extern void timer_wheel_advance(timer_wheel *wheel, unsigned int now)
+{
+    unsigned int level;
+
+    while (wheel->now != now)
+    {
+        wheel->now++;
+
+        /* Each time a level wraps around, cascade the next level's slot */
+        for (level=1; level<TIMER_WHEEL_LEVELS; level++)
+        {
+            if ((wheel->now & ((1U << (TIMER_WHEEL_BITS * level)) - 1)) != 0)
+                break;
+            timer_wheel_cascade(wheel, level);
+        }
+    }
+}
+
+extern sim_timer *timer_wheel_expire(timer_wheel *wheel,
+                                     unsigned int key_limit)
+{
+    sim_timer *head = &wheel->slot[0][wheel->now & TIMER_WHEEL_MASK];
+    sim_timer *timer = head->next;
+
+    /* Every timer in the current level 0 slot is due now, lowest key first */
+    if (timer == head || timer->key >= key_limit)
+        return NULL;
+    timer_wheel_cancel(timer);
+    return timer;
+}
@@ -0,0 +1,69 @@
+/*
+ * timerwheel.h
+ * Multithreaded OS Simulation - hierarchical timer wheel
+ *
+ * The supervisor keeps every pending simulator event (burst end, preemption,
+ * I/O completion) as a sim_timer holding the absolute tick at which it
+ * expires.  Advancing the wheel by one tick and expiring the timers due in
+ * that tick costs O(1) amortized, independent of how many timers are
+ * pending, so the supervisor only touches the CPUs and devices that actually
+ * have an event in the current tick.
+ *
+ * The wheel is not thread safe; it is only used with simulator_mutex held.
+ */
+
+#ifndef __TIMERWHEEL_H__
+#define __TIMERWHEEL_H__
+
+
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS 4
+
+/* Timers can be armed up to this many ticks ahead */
+#define TIMER_WHEEL_SPAN (1U << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS))
+
+/*
+ * A timer.  key orders timers that expire in the same tick: lower keys are
+ * expired first.  A timer is pending while next is non-NULL.
+ */
+typedef struct _sim_timer {
+    unsigned int expires;
+    unsigned int key;
+    struct _sim_timer *next;
+    struct _sim_timer *prev;
+} sim_timer;
+
+/*
+ * Level n slot s holds the timers due in the s-th block of 64^n ticks.  A
+ * slot is the sentinel of a circular doubly-linked list; at level 0, in
+ * key order.
+ */
+typedef struct {
+    unsigned int now;
+    sim_timer slot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} timer_wheel;
+
+
+/*
+ *   timer_wheel_init()    : empties the wheel and sets its time to now
+ *   timer_wheel_add()     : arms a timer; expiry times in the past fire now
+ *   timer_wheel_cancel()  : disarms a timer; a no-op if it is not pending
+ *   timer_wheel_advance() : moves the wheel forward to tick now
+ *   timer_wheel_expire()  : removes and returns the pending timer with the
+ *                           lowest key below key_limit that expires in the
+ *                           current tick, or NULL if there is none
+ */
+extern void timer_wheel_init(timer_wheel *wheel, unsigned int now);
+extern void timer_wheel_add(timer_wheel *wheel, sim_timer *timer,
+                            unsigned int expires, unsigned int key);
+extern void timer_wheel_cancel(sim_timer *timer);
+extern void timer_wheel_advance(timer_wheel *wheel, unsigned int now);
+extern sim_timer *timer_wheel_expire(timer_wheel *wheel,
+                                     unsigned int key_limit);
+
+#define timer_pending(t) ((t)->next != NULL)
+
+
+#endif /* __TIMERWHEEL_H__ */